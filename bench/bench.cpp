@@ -0,0 +1,555 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "../src/corpus.hpp"
+#include "../src/events.hpp"
+#include "../src/midi.hpp"
+#include "../src/mt.hpp"
+
+#include <algorithm>       // std::max
+#include <atomic>          // std::atomic
+#include <chrono>          // std::chrono::steady_clock
+#include <cstddef>         // std::size_t
+#include <cstdio>          // std::printf, std::remove
+#include <cstdlib>         // std::malloc, std::free
+#include <cstring>         // std::strstr
+#include <memory_resource> // std::pmr::monotonic_buffer_resource
+#include <new>             // std::bad_alloc
+#include <string>          // std::string, std::to_string
+#include <thread>          // std::thread::hardware_concurrency
+#include <unordered_set>   // std::unordered_set
+#include <vector>          // std::vector
+
+namespace
+{
+//! Number of calls to operator new so far, from any thread
+std::atomic<std::size_t> allocation_count{0};
+//! Only benchmarks whose name contains this run, all of them if null
+const char *name_filter = nullptr;
+//! Timed runs per benchmark, the fastest is reported to keep noise out of comparisons
+constexpr int repetitions = 3;
+} // namespace
+
+void *operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+
+//! Keeps the optimizer from discarding a value computed inside a benchmark
+template <typename T> void doNotOptimize(T const &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+//! Runs fn(i) for i in [0, iterations) and prints the time, allocations and throughput per item
+/*!
+  items_per_call is the number of items a single call of fn processes, for batch APIs.
+  The loop runs repetitions times and the fastest run is reported; allocations are
+  averaged over every run.
+*/
+template <typename F> void run(const char *name, std::size_t iterations, F &&fn, std::size_t items_per_call = 1)
+{
+    if (name_filter != nullptr && std::strstr(name, name_filter) == nullptr)
+    {
+        return;
+    }
+    std::size_t allocations = allocation_count;
+    double best = 0;
+    for (int repetition = 0; repetition < repetitions; ++repetition)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < iterations; ++i)
+        {
+            fn(i);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        if (repetition == 0 || elapsed.count() < best)
+        {
+            best = elapsed.count();
+        }
+    }
+    double items = static_cast<double>(iterations) * items_per_call;
+    double ns_per_item = best / items;
+    std::printf("%-40s %10.2f ns/op %10.3f allocs/op %10.2f M/s\n", name, ns_per_item,
+                (allocation_count - allocations) / (items * repetitions), 1000.0 / ns_per_item);
+}
+
+//! The Pitch getters and conversions as they were before moving inline into mt.hpp:
+//! calls the optimizer can neither inline nor look through, as across translation units
+[[gnu::noipa]] unsigned short outOfLineMidiValue(const mt::Pitch &p)
+{
+    return p.getMidiValue();
+}
+
+[[gnu::noipa]] mt::PackedPitch outOfLinePack(const mt::Pitch &p)
+{
+    return mt::PackedPitch(p);
+}
+
+[[gnu::noipa]] mt::Pitch outOfLineUnpack(mt::PackedPitch p)
+{
+    return mt::Pitch(p);
+}
+
+//! Format 0 file of count notes on one channel, written with running status
+std::vector<std::uint8_t> makeMidiBytes(std::size_t count)
+{
+    std::vector<std::uint8_t> track = {0x00, 0x90};
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        auto note = static_cast<std::uint8_t>(36 + i * 7 % 48);
+        track.insert(track.end(), {note, 80, 0x83, 0x60, note, 0, 0x00});
+    }
+    track.back() = 0x00;
+    track.insert(track.end(), {0xFF, 0x2F, 0x00});
+    std::vector<std::uint8_t> file = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xE0, 'M', 'T', 'r', 'k'};
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        file.push_back(static_cast<std::uint8_t>(track.size() >> shift));
+    }
+    file.insert(file.end(), track.begin(), track.end());
+    return file;
+}
+
+//! Pitch(std::string) as it was before it was built on parsePitch, kept as a baseline
+[[gnu::noipa]] mt::Pitch legacyPitchFromString(std::string val)
+{
+    std::string error_string = "Failed to parse note: " + val;
+    if (val.length() < 2 || val.length() > 4)
+    {
+        throw mt::PitchParsingException(error_string.c_str());
+    }
+
+    mt::Key key;
+    auto fc = val.at(0);
+    if (fc >= 'a' && fc <= 'g')
+    {
+        key = mt::Key((mt::Key::Type)(fc - 'a'));
+    }
+    else if (fc >= 'A' && fc <= 'G')
+    {
+        key = mt::Key((mt::Key::Type)(fc - 'A'));
+    }
+    else
+    {
+        throw mt::PitchParsingException(error_string.c_str());
+    }
+
+    auto lc = val.back();
+    if (lc < '0' || lc > '9')
+    {
+        throw mt::PitchParsingException(error_string.c_str());
+    }
+    short octave = static_cast<short>(lc - '0');
+
+    mt::Accidental accidental;
+    if (val.length() > 2)
+    {
+        auto fb = val.find_first_of('b');
+        auto fs = val.find_first_of('#');
+        if (fb == std::string::npos && fs == std::string::npos)
+        {
+            throw mt::PitchParsingException(error_string.c_str());
+        }
+        if (val.length() > 3)
+        {
+            if (fb != std::string::npos)
+            {
+                if (val.find_first_of('b', fb + 1) == std::string::npos)
+                {
+                    throw mt::PitchParsingException(error_string.c_str());
+                }
+                accidental = mt::Accidental(mt::Accidental::Type::double_flat);
+            }
+            else
+            {
+                if (val.find_first_of('#', fs + 1) == std::string::npos)
+                {
+                    throw mt::PitchParsingException(error_string.c_str());
+                }
+                accidental = mt::Accidental(mt::Accidental::Type::double_sharp);
+            }
+        }
+        else
+        {
+            accidental = mt::Accidental(fb != std::string::npos ? mt::Accidental::Type::flat
+                                                                : mt::Accidental::Type::sharp);
+        }
+    }
+    return mt::Pitch(key, accidental, octave);
+}
+
+const std::vector<std::string> pitch_names = {"C4", "Bb3", "F##7", "g#2", "Dbb5", "E1", "a0", "B#6"};
+
+} // namespace
+
+//! Usage: mt_bench [name filter]
+int main(int argc, char **argv)
+{
+    const std::size_t iterations = 2000000;
+    if (argc > 1)
+    {
+        name_filter = argv[1];
+    }
+    std::printf("%-40s %16s %20s %14s\n", "benchmark", "time", "allocations", "throughput");
+
+    run("Pitch(std::string), before parsePitch", iterations, [](std::size_t i) {
+        doNotOptimize(legacyPitchFromString(pitch_names[i % pitch_names.size()]));
+    });
+    run("Pitch(std::string)", iterations, [](std::size_t i) {
+        mt::Pitch p(pitch_names[i % pitch_names.size()]);
+        doNotOptimize(p);
+    });
+
+    run("parsePitch(std::string_view)", iterations, [](std::size_t i) {
+        mt::PackedPitch p;
+        doNotOptimize(mt::parsePitch(pitch_names[i % pitch_names.size()], p));
+        doNotOptimize(p);
+    });
+
+    std::string text;
+    for (std::size_t i = 0; i < 1000000; ++i)
+    {
+        text += pitch_names[i % pitch_names.size()];
+        text += i % 16 == 15 ? '\n' : ' ';
+    }
+    std::vector<mt::PackedPitch> parsed(1000000);
+    run("parsePitches (per note)", 20, [&](std::size_t) {
+        doNotOptimize(mt::parsePitches(text.data(), text.data() + text.size(), parsed.data(), parsed.size()));
+    }, parsed.size());
+
+    std::vector<mt::PackedPitch> packed(pitch_names.size());
+    std::vector<mt::Pitch> pitches;
+    for (std::size_t i = 0; i < pitch_names.size(); ++i)
+    {
+        packed[i] = mt::PackedPitch(mt::Pitch(pitch_names[i]));
+        pitches.emplace_back(packed[i]);
+    }
+
+    run("Pitch(unsigned short midi)", iterations, [](std::size_t i) {
+        mt::Pitch p(static_cast<unsigned short>(i & 0x7F), i & 0x80);
+        doNotOptimize(p);
+    });
+
+    run("Pitch::getFrequency", iterations,
+        [&](std::size_t i) { doNotOptimize(pitches[i % pitches.size()].getFrequency()); });
+    run("Pitch::getMidiValue (sum, per pitch)", 2000, [&](std::size_t) {
+        unsigned sum = 0;
+        for (auto &p : pitches)
+        {
+            sum += p.getMidiValue();
+        }
+        doNotOptimize(sum);
+    }, pitches.size());
+    run("Pitch -> PackedPitch -> Pitch", iterations, [&](std::size_t i) {
+        mt::PackedPitch packed_pitch(pitches[i % pitches.size()]);
+        doNotOptimize(mt::Pitch(packed_pitch));
+    });
+    run("Pitch::getMidiValue (sum, out of line)", 2000, [&](std::size_t) {
+        unsigned sum = 0;
+        for (auto &p : pitches)
+        {
+            sum += outOfLineMidiValue(p);
+        }
+        doNotOptimize(sum);
+    }, pitches.size());
+    run("Pitch -> Packed -> Pitch (out of line)", iterations, [&](std::size_t i) {
+        doNotOptimize(outOfLineUnpack(outOfLinePack(pitches[i % pitches.size()])));
+    });
+
+    std::vector<float> bends(4096), hz(bends.size());
+    for (std::size_t i = 0; i < bends.size(); ++i)
+    {
+        bends[i] = 21 + (i % 880) * 0.1f;
+    }
+    run("midiToFrequencies (float, per note)", 2000, [&](std::size_t) {
+        mt::midiToFrequencies(bends.data(), bends.size(), hz.data());
+        doNotOptimize(hz.data());
+    }, bends.size());
+    run("frequenciesToMidi (per note)", 2000, [&](std::size_t) {
+        mt::frequenciesToMidi(hz.data(), hz.size(), bends.data());
+        doNotOptimize(bends.data());
+    }, bends.size());
+
+    std::vector<mt::PitchEstimate> estimates(hz.size());
+    run("nearestPitches (per frequency)", 2000, [&](std::size_t) {
+        mt::nearestPitches(hz.data(), hz.size(), estimates.data());
+        doNotOptimize(estimates.data());
+    }, hz.size());
+
+    using Quality = mt::Interval::Quality;
+    static const Quality qualities[] = {Quality::perfect, Quality::major,     Quality::minor,    Quality::perfect,
+                                        Quality::perfect, Quality::augmented, Quality::diminished};
+    static const unsigned short degrees[] = {1, 3, 6, 4, 12, 4, 5};
+    run("Interval(Quality, degree)", iterations, [&](std::size_t i) {
+        doNotOptimize(mt::Interval(qualities[i % 7], degrees[i % 7]));
+    });
+    run("Interval(semitones)", iterations, [&](std::size_t i) {
+        doNotOptimize(mt::Interval(static_cast<unsigned short>(i % 25)));
+    });
+    run("Interval(semitones, degree)", iterations, [&](std::size_t i) {
+        doNotOptimize(mt::Interval(static_cast<unsigned short>(i % 12), static_cast<unsigned short>(1 + i % 12 / 2)));
+    });
+    run("Interval::getSemitones", iterations, [&](std::size_t i) {
+        doNotOptimize(mt::Interval(qualities[i % 7], degrees[i % 7]).getSemitones());
+    });
+    run("Interval::toString", iterations, [&](std::size_t i) {
+        doNotOptimize(mt::Interval(qualities[i % 7], degrees[i % 7]).toString());
+    });
+
+    using namespace mt::Intervals;
+    mt::Scale major({P1, M2, M3, P4, P5, M6, M7});
+    std::vector<mt::Interval> major_intervals = major.getIntervals();
+    run("Scale::getPitchesFromRoot", iterations / 10, [&](std::size_t i) {
+        doNotOptimize(major.getPitchesFromRoot(mt::Pitch(static_cast<unsigned short>(36 + i % 48))));
+    });
+    std::pmr::monotonic_buffer_resource arena;
+    run("Scale::getPitchesFromRoot (arena)", iterations / 10, [&](std::size_t i) {
+        doNotOptimize(major.getPitchesFromRoot(mt::Pitch(static_cast<unsigned short>(36 + i % 48)), &arena));
+        if (i % 1024 == 1023)
+        {
+            arena.release();
+        }
+    });
+    run("Chord build + getIntervalSpan", iterations, [&](std::size_t i) {
+        mt::Chord chord({P1, i % 2 ? M3 : m3, P5, i % 3 ? m7 : M7});
+        unsigned sum = 0;
+        for (mt::Interval interval : chord.getIntervalSpan())
+        {
+            sum += interval.getSemitones();
+        }
+        doNotOptimize(sum);
+    });
+    std::unordered_set<mt::Chord> seen_chords;
+    for (const mt::CatalogScale &entry : mt::scaleCatalog())
+    {
+        seen_chords.insert(mt::Chord(entry.scale.getIntervalSpan()));
+    }
+    std::vector<mt::Chord> probes;
+    for (std::size_t i = 0; i < 64; ++i)
+    {
+        probes.push_back(mt::PitchClassSet(static_cast<std::uint16_t>(i * 0x9E5 + 1)).toChord());
+    }
+    run("unordered_set<Chord>::count", iterations, [&](std::size_t i) {
+        doNotOptimize(seen_chords.count(probes[i % probes.size()]));
+    });
+    run("Scales::major::getPitchesFromRoot", iterations, [&](std::size_t i) {
+        doNotOptimize(mt::Scales::major::getPitchesFromRoot(mt::PackedPitch::fromMidi(36 + i % 48)));
+    });
+    run("getPitchFromRoot per degree", iterations / 10, [&](std::size_t i) {
+        mt::Pitch root(static_cast<unsigned short>(36 + i % 48));
+        std::vector<mt::Pitch> pitches;
+        pitches.reserve(major_intervals.size());
+        for (auto interval : major_intervals)
+        {
+            pitches.push_back(interval.getPitchFromRoot(root));
+        }
+        doNotOptimize(pitches);
+    });
+
+    std::vector<mt::PackedPitch> transposed(1024);
+    for (std::size_t i = 0; i < transposed.size(); ++i)
+    {
+        transposed[i] = mt::PackedPitch::fromMidi(static_cast<std::uint8_t>(48 + i % 24), i % 2 == 0);
+    }
+    run("transpose (per note)", 2000, [&](std::size_t) {
+        doNotOptimize(mt::transpose(transposed.data(), transposed.size(), mt::Intervals::m3));
+        doNotOptimize(mt::transpose(transposed.data(), transposed.size(), mt::Intervals::m3, false));
+    }, 2 * transposed.size());
+    run("intervalBetween", iterations, [&](std::size_t i) {
+        doNotOptimize(mt::intervalBetween(transposed[i % transposed.size()], transposed[(i + 7) % transposed.size()]));
+    });
+    std::vector<std::int16_t> melodic_semitones(transposed.size());
+    std::vector<std::int16_t> melodic_steps(transposed.size());
+    run("melodicIntervals (per note)", 2000, [&](std::size_t) {
+        mt::melodicIntervals(transposed.data(), transposed.size(), melodic_semitones.data(), melodic_steps.data());
+        doNotOptimize(melodic_steps.data());
+    }, transposed.size());
+
+    std::vector<mt::PackedPitch> voicings;
+    for (std::size_t i = 0; i < 4 * 1024; ++i)
+    {
+        voicings.push_back(mt::PackedPitch::fromMidi(static_cast<std::uint8_t>(40 + (i * 7 + i / 4 * 5) % 40)));
+    }
+    run("recognizeChord (4 packed pitches)", iterations, [&](std::size_t i) {
+        doNotOptimize(mt::recognizeChord(voicings.data() + (i % 1024) * 4, 4));
+    });
+
+    std::vector<mt::Pitch> melody = {mt::Pitch("C4"), mt::Pitch("D4"), mt::Pitch("E4"), mt::Pitch("G4")};
+    run("findScales (4 pitches)", iterations / 100, [&](std::size_t) { doNotOptimize(mt::findScales(melody)); });
+    std::vector<mt::CatalogScale> catalog = mt::scaleCatalog();
+    run("naive getPitchesFromRoot scan", iterations / 1000, [&](std::size_t) {
+        std::vector<std::pair<const char *, int>> found;
+        for (auto &entry : catalog)
+        {
+            for (unsigned short root = 0; root < 12; ++root)
+            {
+                auto scale_pitches = entry.scale.getPitchesFromRoot(mt::Pitch(static_cast<unsigned short>(60 + root)));
+                bool contains = true;
+                for (auto p : melody)
+                {
+                    bool found_pitch = false;
+                    for (auto s : scale_pitches)
+                    {
+                        found_pitch = found_pitch || s.getMidiValue() % 12 == p.getMidiValue() % 12;
+                    }
+                    contains = contains && found_pitch;
+                }
+                if (contains)
+                {
+                    found.emplace_back(entry.name, root);
+                }
+            }
+        }
+        doNotOptimize(found);
+    });
+
+    std::vector<std::uint8_t> midi_bytes = makeMidiBytes(100000);
+    mt::MidiFile midi_file;
+    run("parseMidi (per note)", 20, [&](std::size_t) {
+        mt::parseMidi(midi_bytes.data(), midi_bytes.size(), midi_file);
+        doNotOptimize(midi_file.notes.size());
+    }, 100000);
+
+    mt::MidiWriter midi_writer;
+    run("MidiWriter::encode (per note)", 20, [&](std::size_t) {
+        doNotOptimize(midi_writer.encode(midi_file.notes).data());
+    }, midi_file.notes.size());
+
+    const mt::MidiNotes notes = mt::parseMidi(midi_bytes.data(), midi_bytes.size()).notes;
+    run("EventStore append + sortByOnset (per note)", 20, [&](std::size_t) {
+        mt::EventStore store;
+        store.reserve(notes.size());
+        for (std::size_t n = notes.size(); n-- > 0;)
+        {
+            store.append(notes.ticks[n], notes.durations[n], mt::PackedPitch::fromMidi(notes.notes[n]),
+                         notes.velocities[n], notes.channels[n]);
+        }
+        store.sortByOnset();
+        doNotOptimize(store.getOnsets());
+    }, notes.size());
+
+    mt::EventStore store;
+    store.reserve(notes.size());
+    for (std::size_t n = 0; n < notes.size(); ++n)
+    {
+        store.append(notes.ticks[n], notes.durations[n], mt::PackedPitch::fromMidi(notes.notes[n]),
+                     notes.velocities[n], notes.channels[n]);
+    }
+    store.sortByOnset();
+    const std::uint32_t last_onset = store.size() ? store.getOnsets()[store.size() - 1] : 0;
+    run("EventStore::slice", iterations, [&](std::size_t i) {
+        auto from = static_cast<std::uint32_t>(i * 7919 % (last_onset + 1));
+        doNotOptimize(store.slice(from, from + 1920).size);
+    });
+
+    // The same notes, found again by re-parsing the MIDI file or from a corpus queried in place
+    mt::MidiFile reparsed;
+    run("parseMidi + pitch sum (per note)", 20, [&](std::size_t) {
+        mt::parseMidi(midi_bytes.data(), midi_bytes.size(), reparsed);
+        unsigned sum = 0;
+        for (std::uint8_t note : reparsed.notes.notes)
+        {
+            sum += note;
+        }
+        doNotOptimize(sum);
+    }, notes.size());
+
+    mt::CorpusWriter corpus_writer;
+    corpus_writer.add(store, 480);
+    const std::vector<std::uint8_t> &corpus_bytes = corpus_writer.encode();
+    run("Corpus open + pitch sum (per note)", 20, [&](std::size_t) {
+        mt::Corpus corpus(corpus_bytes.data(), corpus_bytes.size());
+        mt::EventView score = corpus.getScore(0);
+        unsigned sum = 0;
+        for (std::size_t n = 0; n < score.size; ++n)
+        {
+            sum += score.pitches[n].getBits();
+        }
+        doNotOptimize(sum);
+    }, notes.size());
+
+    // Scaling of parallel ingestion, 64 files of 5000 notes from 1 thread up to the machine's
+    std::vector<std::string> corpus_paths;
+    std::vector<std::uint8_t> small_midi = makeMidiBytes(5000);
+    for (int f = 0; f < 64; ++f)
+    {
+        corpus_paths.push_back("mt_bench_" + std::to_string(f) + ".mid");
+        mt::writeWholeFile(corpus_paths.back(), small_midi.data(), small_midi.size());
+    }
+    std::vector<std::size_t> thread_counts = {1, 2, 4};
+    std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    if (hardware > 4)
+    {
+        thread_counts.push_back(hardware);
+    }
+    for (std::size_t threads : thread_counts)
+    {
+        mt::ThreadPool pool(threads);
+        std::string name = "loadScoreFiles, " + std::to_string(threads) + " of " + std::to_string(hardware) +
+                           " threads (per note)";
+        run(name.c_str(), 5, [&](std::size_t) {
+            mt::CorpusWriter writer;
+            mt::loadScoreFiles(corpus_paths, writer, pool);
+            doNotOptimize(writer.scoreCount());
+        }, corpus_paths.size() * 5000);
+    }
+    for (const std::string &path : corpus_paths)
+    {
+        std::remove(path.c_str());
+    }
+
+    run("Pitch::toString", iterations, [&](std::size_t i) { doNotOptimize(pitches[i % pitches.size()].toString()); });
+
+    char buffer[16];
+    run("PackedPitch::toChars", iterations, [&](std::size_t i) {
+        doNotOptimize(packed[i % packed.size()].toChars(buffer, buffer + sizeof(buffer)));
+        doNotOptimize(buffer);
+    });
+
+    std::vector<char> csv(parsed.size() * 6);
+    run("formatPitches (per note)", 20, [&](std::size_t) {
+        doNotOptimize(mt::formatPitches(parsed.data(), parsed.size(), csv.data(), csv.data() + csv.size(), ','));
+    }, parsed.size());
+
+    return 0;
+}
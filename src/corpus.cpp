@@ -0,0 +1,528 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "corpus.hpp"
+
+#include <algorithm>   // std::sort
+#include <cstring>     // std::memcmp, std::memcpy
+#include <filesystem>  // std::filesystem::recursive_directory_iterator
+#include <optional>    // std::optional
+#include <stdexcept>   // std::out_of_range
+#include <type_traits> // std::is_trivially_copyable
+
+namespace mt
+{
+
+namespace
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+constexpr bool little_endian_host = false;
+#else
+constexpr bool little_endian_host = true;
+#endif
+
+static_assert(sizeof(PackedPitch) == 2 && std::is_trivially_copyable<PackedPitch>::value,
+              "The pitch column is read and written as raw PackedPitch bits");
+
+constexpr char magic[8] = {'M', 'T', 'C', 'O', 'R', 'P', 'U', 'S'};
+constexpr std::size_t header_size = 128;
+constexpr std::size_t alignment = 64;
+
+//! Byte offsets of the header fields
+enum Field : std::size_t
+{
+    version_field = 8,
+    header_size_field = 12,
+    score_count_field = 16,
+    event_count_field = 24,
+    scores_field = 32,
+    divisions_field = 40,
+    onsets_field = 48,
+    durations_field = 56,
+    pitches_field = 64,
+    velocities_field = 72,
+    voices_field = 80,
+    file_size_field = 88
+};
+
+template <typename T> T load(const std::uint8_t *p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+template <typename T> void store(std::uint8_t *p, T value)
+{
+    std::memcpy(p, &value, sizeof(T));
+}
+
+std::uint64_t alignUp(std::uint64_t offset)
+{
+    return (offset + alignment - 1) & ~std::uint64_t(alignment - 1);
+}
+
+//! Checks that a section lies inside the file, returning its offset
+std::uint64_t section(const std::uint8_t *data, std::size_t size, Field field, std::uint64_t count,
+                      std::size_t element_size)
+{
+    std::uint64_t offset = load<std::uint64_t>(data + field);
+    if (offset % alignment != 0 || offset < header_size || offset > size ||
+        count > (size - offset) / element_size)
+    {
+        throw CorpusException("Invalid corpus: section out of bounds or misaligned");
+    }
+    return offset;
+}
+} // namespace
+
+/**
+ * @brief Memory-maps and opens a corpus file
+ *
+ * @details Throws std::system_error if the file can't be read, CorpusException if it
+ * isn't a valid corpus
+ *
+ * @param path Path to the file
+ */
+Corpus::Corpus(const std::string &path) : file(std::make_unique<MappedFile>(path))
+{
+    open(file->data(), file->size());
+}
+
+/**
+ * @brief Opens a corpus held in memory, without copying it
+ *
+ * @param data Bytes of the corpus, 8 byte aligned
+ * @param size Number of bytes
+ */
+Corpus::Corpus(const std::uint8_t *data, std::size_t size)
+{
+    open(data, size);
+}
+
+/**
+ * @brief Checks the header and score table and points the columns into the data
+ *
+ * @details Costs O(scores): the event columns themselves are never touched, so
+ * opening a corpus only faults in its first pages
+ *
+ * @param data Bytes of the corpus
+ * @param size Number of bytes
+ */
+void Corpus::open(const std::uint8_t *data, std::size_t size)
+{
+    if (!little_endian_host)
+    {
+        throw CorpusException("Corpus files can only be read on little-endian hosts");
+    }
+    if (size < header_size || std::memcmp(data, magic, sizeof(magic)) != 0)
+    {
+        throw CorpusException("Invalid corpus: missing MTCORPUS header");
+    }
+    if (reinterpret_cast<std::uintptr_t>(data) % alignof(std::uint64_t) != 0)
+    {
+        throw CorpusException("Corpus data must be 8 byte aligned");
+    }
+    if (load<std::uint32_t>(data + version_field) != corpus_version)
+    {
+        throw CorpusException("Unsupported corpus version");
+    }
+    if (load<std::uint32_t>(data + header_size_field) != header_size ||
+        load<std::uint64_t>(data + file_size_field) != size)
+    {
+        throw CorpusException("Invalid corpus: header doesn't match the file size");
+    }
+
+    std::uint64_t scores = load<std::uint64_t>(data + score_count_field);
+    std::uint64_t count = load<std::uint64_t>(data + event_count_field);
+    if (scores >= size || count > size)
+    {
+        throw CorpusException("Invalid corpus: section out of bounds or misaligned");
+    }
+
+    score_starts = reinterpret_cast<const std::uint64_t *>(data + section(data, size, scores_field, scores + 1, 8));
+    divisions = reinterpret_cast<const std::uint32_t *>(data + section(data, size, divisions_field, scores, 4));
+    if (score_starts[0] != 0 || score_starts[scores] != count)
+    {
+        throw CorpusException("Invalid corpus: score table doesn't cover the events");
+    }
+    for (std::uint64_t i = 0; i < scores; ++i)
+    {
+        if (score_starts[i + 1] < score_starts[i])
+        {
+            throw CorpusException("Invalid corpus: score table out of order");
+        }
+    }
+
+    score_count = static_cast<std::size_t>(scores);
+    events.onsets = reinterpret_cast<const std::uint32_t *>(data + section(data, size, onsets_field, count, 4));
+    events.durations = reinterpret_cast<const std::uint32_t *>(data + section(data, size, durations_field, count, 4));
+    events.pitches = reinterpret_cast<const PackedPitch *>(data + section(data, size, pitches_field, count, 2));
+    events.velocities = data + section(data, size, velocities_field, count, 1);
+    events.voices = reinterpret_cast<const std::uint16_t *>(data + section(data, size, voices_field, count, 2));
+    events.size = static_cast<std::size_t>(count);
+}
+
+/**
+ * @brief Returns the events of one score, sorted by onset
+ *
+ * @details Throws std::out_of_range if there's no such score. The view points into
+ * the corpus, narrow it further with sliceByOnset
+ *
+ * @param score Index of the score
+ * @return EventView
+ */
+EventView Corpus::getScore(std::size_t score) const
+{
+    if (score >= score_count)
+    {
+        throw std::out_of_range("Corpus score index out of range");
+    }
+    auto first = static_cast<std::size_t>(score_starts[score]);
+    auto last = static_cast<std::size_t>(score_starts[score + 1]);
+    return {events.onsets + first,     events.durations + first, events.pitches + first,
+            events.velocities + first, events.voices + first,    last - first};
+}
+
+/**
+ * @brief Returns the ticks per quarter note of one score
+ *
+ * @details Throws std::out_of_range if there's no such score
+ *
+ * @param score Index of the score
+ * @return std::uint32_t
+ */
+std::uint32_t Corpus::getDivision(std::size_t score) const
+{
+    if (score >= score_count)
+    {
+        throw std::out_of_range("Corpus score index out of range");
+    }
+    return divisions[score];
+}
+
+/**
+ * @brief Copies an event store in as the next score
+ *
+ * @details Throws std::logic_error if the store isn't sorted by onset
+ *
+ * @param score Events of the score
+ * @param division Ticks per quarter note
+ */
+void CorpusWriter::add(const EventStore &score, std::uint32_t division)
+{
+    if (!score.isSorted())
+    {
+        throw std::logic_error("EventStore must be sorted by onset before adding it to a corpus");
+    }
+    EventView view = score.view();
+    onsets.insert(onsets.end(), view.onsets, view.onsets + view.size);
+    durations.insert(durations.end(), view.durations, view.durations + view.size);
+    pitches.insert(pitches.end(), view.pitches, view.pitches + view.size);
+    velocities.insert(velocities.end(), view.velocities, view.velocities + view.size);
+    voices.insert(voices.end(), view.voices, view.voices + view.size);
+    score_starts.push_back(onsets.size());
+    divisions.push_back(division);
+}
+
+/**
+ * @brief Replaces the contents of an event store with the notes of a MIDI file
+ *
+ * @details Each note's voice is track * 16 + channel, and the store ends up sorted by
+ * onset. Throws CorpusException if the file has more than 4096 tracks
+ *
+ * @param notes Notes of a parsed MIDI file
+ * @param events Receives the events
+ * @param use_sharps Spell black keys with sharps rather than flats
+ */
+void midiToEvents(const MidiNotes &notes, EventStore &events, bool use_sharps)
+{
+    events.clear();
+    events.reserve(notes.size());
+    for (std::size_t i = 0; i < notes.size(); ++i)
+    {
+        if (notes.tracks[i] >= 4096)
+        {
+            throw CorpusException("MIDI file has too many tracks to number its voices");
+        }
+        events.append(notes.ticks[i], notes.durations[i], PackedPitch::fromMidi(notes.notes[i], use_sharps),
+                      notes.velocities[i], static_cast<std::uint16_t>(notes.tracks[i] * 16 + notes.channels[i]));
+    }
+    events.sortByOnset();
+}
+
+/**
+ * @brief Converts the notes of a Standard MIDI File and adds them as the next score
+ *
+ * @details See midiToEvents
+ *
+ * @param file Parsed MIDI file
+ * @param use_sharps Spell black keys with sharps rather than flats
+ */
+void CorpusWriter::add(const MidiFile &file, bool use_sharps)
+{
+    midiToEvents(file.notes, scratch, use_sharps);
+    add(scratch, file.division);
+}
+
+/**
+ * @brief Drops every score added so far, keeping the capacity
+ */
+void CorpusWriter::clear() noexcept
+{
+    score_starts.resize(1);
+    divisions.clear();
+    onsets.clear();
+    durations.clear();
+    pitches.clear();
+    velocities.clear();
+    voices.clear();
+}
+
+/**
+ * @brief Lays out every score added so far as a corpus file in memory
+ *
+ * @details The returned buffer stays valid until the next call to encode, write or
+ * the writer's destruction. Throws CorpusException on big-endian hosts
+ *
+ * @return const std::vector<std::uint8_t>&
+ */
+const std::vector<std::uint8_t> &CorpusWriter::encode()
+{
+    if (!little_endian_host)
+    {
+        throw CorpusException("Corpus files can only be written on little-endian hosts");
+    }
+    const std::uint64_t scores = divisions.size();
+    const std::uint64_t count = onsets.size();
+
+    std::uint64_t offsets[7];
+    std::uint64_t sizes[7] = {(scores + 1) * 8, scores * 4, count * 4, count * 4, count * 2, count, count * 2};
+    std::uint64_t end = header_size;
+    for (int i = 0; i < 7; ++i)
+    {
+        offsets[i] = end;
+        end = alignUp(end + sizes[i]);
+    }
+
+    buffer.assign(static_cast<std::size_t>(end), 0);
+    std::uint8_t *data = buffer.data();
+    std::memcpy(data, magic, sizeof(magic));
+    store<std::uint32_t>(data + version_field, corpus_version);
+    store<std::uint32_t>(data + header_size_field, header_size);
+    store<std::uint64_t>(data + score_count_field, scores);
+    store<std::uint64_t>(data + event_count_field, count);
+    for (int i = 0; i < 7; ++i)
+    {
+        store<std::uint64_t>(data + scores_field + 8 * i, offsets[i]);
+    }
+    store<std::uint64_t>(data + file_size_field, end);
+
+    const void *columns[7] = {score_starts.data(), divisions.data(), onsets.data(), durations.data(),
+                              pitches.data(),      velocities.data(), voices.data()};
+    for (int i = 0; i < 7; ++i)
+    {
+        if (sizes[i])
+        {
+            std::memcpy(data + offsets[i], columns[i], static_cast<std::size_t>(sizes[i]));
+        }
+    }
+    return buffer;
+}
+
+/**
+ * @brief Encodes every score added so far and writes the corpus to a file
+ *
+ * @param path Path to the file
+ */
+void CorpusWriter::write(const std::string &path)
+{
+    const std::vector<std::uint8_t> &bytes = encode();
+    writeWholeFile(path, bytes.data(), bytes.size());
+}
+
+namespace
+{
+//! Reads a MIDI file, naming it in any MidiFileException
+void readNamedMidiFile(const std::string &path, MidiFile &file)
+{
+    try
+    {
+        readMidiFile(path, file);
+    }
+    catch (const MidiFileException &e)
+    {
+        throw MidiFileException((path + ": " + e.what()).c_str());
+    }
+}
+
+//! Ticks per beat of scores read from pitch lists, CorpusWriter's default division
+constexpr std::uint32_t text_division = 480;
+
+//! Whether a path names a pitch list rather than a Standard MIDI File
+bool isPitchText(const std::filesystem::path &path)
+{
+    return path.extension() == ".txt";
+}
+
+//! Reads a pitch list as one beat notes in a row, naming the file in any PitchParsingException
+void readPitchText(const std::string &path, std::vector<PackedPitch> &pitches, EventStore &events)
+{
+    MappedFile file(path);
+    const char *first = reinterpret_cast<const char *>(file.data());
+    const char *last = first + file.size();
+    pitches.resize(file.size() / 3 + 1); // Names take at least 2 characters plus a separator
+    PitchBatchResult result = parsePitches(first, last, pitches.data(), pitches.size());
+    if (result.ec != std::errc())
+    {
+        throw PitchParsingException(
+            (path + ": invalid pitch name at byte " + std::to_string(result.ptr - first)).c_str());
+    }
+    events.reserve(result.count);
+    for (std::size_t i = 0; i < result.count; ++i)
+    {
+        events.append(static_cast<std::uint32_t>(i * text_division), text_division, pitches[i]);
+    }
+}
+
+//! What each worker of loadScoreFiles keeps between files
+struct LoaderWorker
+{
+    std::pmr::monotonic_buffer_resource arena;
+    MidiFile file;
+    std::vector<PackedPitch> pitches;
+};
+} // namespace
+
+/**
+ * @brief Lists the score files under a directory, in its subdirectories too
+ *
+ * @details Finds Standard MIDI Files (.mid, .midi) and pitch lists (.txt), sorted by
+ * path so a corpus built from them doesn't depend on the order the file system lists
+ * them in. Throws std::filesystem::filesystem_error if the directory can't be read
+ *
+ * @param directory Directory to search
+ * @return std::vector<std::string>
+ */
+std::vector<std::string> findScoreFiles(const std::string &directory)
+{
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(directory))
+    {
+        const std::filesystem::path &path = entry.path();
+        if (entry.is_regular_file() &&
+            (path.extension() == ".mid" || path.extension() == ".midi" || isPitchText(path)))
+        {
+            paths.push_back(path.string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+/**
+ * @brief Reads score files in parallel and adds them to a corpus, a score per file
+ *
+ * @details Files ending in .txt are pitch lists, names as accepted by parsePitches,
+ * read as a melody of one beat notes at a division of 480. Every other file is read
+ * as a Standard MIDI File. The pool's workers take files off their queues, stealing
+ * from one another when they run dry, and parse each into an EventStore allocated
+ * from that worker's own arena, so no allocator lock is shared between threads. The
+ * stores are then added to the writer in the order of paths, so the corpus is the
+ * same whatever the number of threads. Throws MidiFileException or
+ * PitchParsingException naming a file that fails to parse
+ *
+ * @param paths Files to read, in the order their scores should appear
+ * @param writer Receives one score per file
+ * @param pool Threads to parse with
+ * @param use_sharps Spell black keys from MIDI files with sharps rather than flats
+ */
+void loadScoreFiles(const std::vector<std::string> &paths, CorpusWriter &writer, ThreadPool &pool, bool use_sharps)
+{
+    std::vector<std::unique_ptr<LoaderWorker>> workers;
+    for (std::size_t w = 0; w < pool.size(); ++w)
+    {
+        workers.push_back(std::make_unique<LoaderWorker>());
+    }
+    std::vector<std::optional<EventStore>> scores(paths.size());
+    std::vector<std::uint32_t> divisions(paths.size());
+
+    pool.run(paths.size(), [&](std::size_t i, std::size_t w) {
+        LoaderWorker &worker = *workers[w];
+        EventStore &score = scores[i].emplace(&worker.arena);
+        if (isPitchText(paths[i]))
+        {
+            readPitchText(paths[i], worker.pitches, score);
+            divisions[i] = text_division;
+        }
+        else
+        {
+            readNamedMidiFile(paths[i], worker.file);
+            midiToEvents(worker.file.notes, score, use_sharps);
+            divisions[i] = worker.file.division;
+        }
+    });
+
+    for (std::size_t i = 0; i < scores.size(); ++i)
+    {
+        writer.add(*scores[i], divisions[i]);
+    }
+}
+
+/**
+ * @brief Reads every score file under a directory in parallel, see findScoreFiles
+ * and loadScoreFiles
+ *
+ * @param directory Directory to search
+ * @param writer Receives one score per file, in path order
+ * @param pool Threads to parse with
+ * @param use_sharps Spell black keys from MIDI files with sharps rather than flats
+ */
+void loadScoreDirectory(const std::string &directory, CorpusWriter &writer, ThreadPool &pool, bool use_sharps)
+{
+    loadScoreFiles(findScoreFiles(directory), writer, pool, use_sharps);
+}
+
+/**
+ * @brief Reads Standard MIDI Files and writes them out as one corpus, a score per file
+ *
+ * @details Throws MidiFileException naming the first file that fails to parse
+ *
+ * @param midi_paths Files to convert, in the order their scores should appear
+ * @param corpus_path Path of the corpus to write
+ * @param use_sharps Spell black keys with sharps rather than flats
+ */
+void convertMidiFiles(const std::vector<std::string> &midi_paths, const std::string &corpus_path, bool use_sharps)
+{
+    CorpusWriter writer;
+    MidiFile file;
+    for (const std::string &path : midi_paths)
+    {
+        readNamedMidiFile(path, file);
+        writer.add(file, use_sharps);
+    }
+    writer.write(corpus_path);
+}
+
+} // namespace mt
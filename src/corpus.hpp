@@ -0,0 +1,152 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "events.hpp"
+#include "mapped_file.hpp"
+#include "midi.hpp"
+#include "thread_pool.hpp"
+
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint8_t, std::uint32_t, std::uint64_t
+#include <memory>    // std::unique_ptr
+#include <stdexcept> // std::runtime_error
+#include <string>    // std::string
+#include <vector>    // std::vector
+
+namespace mt
+{
+
+//! Exception for when a corpus file can't be read or written
+class CorpusException : public std::runtime_error
+{
+  public:
+    CorpusException(char const *const message) throw() : std::runtime_error(message)
+    {
+    }
+};
+
+//! Version written to, and the only one accepted from, the corpus header
+constexpr std::uint32_t corpus_version = 1;
+
+//! Collection of scores in the binary corpus format, queried in place
+/*!
+  A corpus file is little-endian and starts with a 128 byte header:
+
+      offset  size  field
+           0     8  magic "MTCORPUS"
+           8     4  version
+          12     4  header size, 128
+          16     8  number of scores S
+          24     8  number of events N
+          32     8  offset of the score table, S + 1 u64 first event indices
+          40     8  offset of the divisions, S u32 ticks per quarter note
+          48     8  offset of the onsets, N u32 ticks
+          56     8  offset of the durations, N u32 ticks
+          64     8  offset of the pitches, N u16 PackedPitch bits
+          72     8  offset of the velocities, N u8
+          80     8  offset of the voices, N u16
+          88     8  file size, a multiple of 64
+          96    32  reserved, zero
+
+  Every section starts on a 64 byte boundary and the events of each score are sorted
+  by onset, so once the header and score table are checked the columns are read
+  straight out of the mapping as EventViews, with no decoding step. Only
+  little-endian hosts can open a corpus. Throws CorpusException if the data isn't
+  a valid corpus.
+*/
+class Corpus
+{
+  public:
+    explicit Corpus(const std::string &path);
+    //! Reads a corpus held in memory, which must stay alive and be 8 byte aligned
+    Corpus(const std::uint8_t *data, std::size_t size);
+
+    std::size_t scoreCount() const noexcept
+    {
+        return score_count;
+    }
+    std::size_t eventCount() const noexcept
+    {
+        return events.size;
+    }
+    //! Events of every score, one after the other
+    const EventView &getEvents() const noexcept
+    {
+        return events;
+    }
+    EventView getScore(std::size_t score) const;
+    std::uint32_t getDivision(std::size_t score) const;
+
+  private:
+    void open(const std::uint8_t *data, std::size_t size);
+
+    std::unique_ptr<MappedFile> file;
+    std::size_t score_count = 0;
+    const std::uint64_t *score_starts = nullptr;
+    const std::uint32_t *divisions = nullptr;
+    EventView events{};
+};
+
+//! Builds a corpus file from event stores and Standard MIDI Files
+/*!
+  Scores are copied in as they are added, so the sources can be reused or freed
+  straight away. encode and write can be called repeatedly as more scores arrive.
+*/
+class CorpusWriter
+{
+  public:
+    void add(const EventStore &score, std::uint32_t division = 480);
+    void add(const MidiFile &file, bool use_sharps = true);
+    std::size_t scoreCount() const noexcept
+    {
+        return divisions.size();
+    }
+    void clear() noexcept;
+
+    const std::vector<std::uint8_t> &encode();
+    void write(const std::string &path);
+
+  private:
+    std::vector<std::uint64_t> score_starts{0};
+    std::vector<std::uint32_t> divisions;
+    std::vector<std::uint32_t> onsets;
+    std::vector<std::uint32_t> durations;
+    std::vector<PackedPitch> pitches;
+    std::vector<std::uint8_t> velocities;
+    std::vector<std::uint16_t> voices;
+    EventStore scratch; //!< Sorts MIDI notes, which arrive grouped by track
+    std::vector<std::uint8_t> buffer;
+};
+
+void midiToEvents(const MidiNotes &notes, EventStore &events, bool use_sharps = true);
+std::vector<std::string> findScoreFiles(const std::string &directory);
+void loadScoreFiles(const std::vector<std::string> &paths, CorpusWriter &writer, ThreadPool &pool,
+                    bool use_sharps = true);
+void loadScoreDirectory(const std::string &directory, CorpusWriter &writer, ThreadPool &pool, bool use_sharps = true);
+void convertMidiFiles(const std::vector<std::string> &midi_paths, const std::string &corpus_path,
+                      bool use_sharps = true);
+
+} // namespace mt
@@ -0,0 +1,223 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "events.hpp"
+
+#include <algorithm> // std::lower_bound, std::sort
+#include <stdexcept> // std::length_error, std::logic_error
+
+namespace mt
+{
+
+/**
+ * @brief Creates an empty store
+ *
+ * @param resource Arena the columns allocate from, or nullptr for the store to own a
+ * monotonic one
+ */
+EventStore::EventStore(std::pmr::memory_resource *resource)
+    : owned_arena(resource ? nullptr : std::make_unique<std::pmr::monotonic_buffer_resource>()),
+      arena(resource ? resource : owned_arena.get()), onsets(arena), durations(arena), pitches(arena),
+      velocities(arena), voices(arena), sort_keys(arena)
+{
+}
+
+/**
+ * @brief Appends one event to every column
+ *
+ * @details Throws std::length_error if the store already holds max_size events
+ *
+ * @param onset Start in ticks
+ * @param duration Length in ticks
+ * @param pitch Spelled pitch of the note
+ * @param velocity Loudness, 0 to 127 by convention
+ * @param voice Voice, track or part the event belongs to
+ */
+void EventStore::append(std::uint32_t onset, std::uint32_t duration, PackedPitch pitch, std::uint8_t velocity,
+                        std::uint16_t voice)
+{
+    if (onsets.size() >= max_size)
+    {
+        throw std::length_error("EventStore can't hold more than 2^32 - 1 events");
+    }
+    if (!onsets.empty() && onset < onsets.back())
+    {
+        sorted = false;
+    }
+    onsets.push_back(onset);
+    durations.push_back(duration);
+    pitches.push_back(pitch);
+    velocities.push_back(velocity);
+    voices.push_back(voice);
+}
+
+/**
+ * @brief Reserves room for count events in every column
+ *
+ * @details Worth calling up front: a monotonic arena never reuses the blocks a
+ * column leaves behind when it grows. Throws std::length_error if count is over max_size
+ *
+ * @param count Number of events
+ */
+void EventStore::reserve(std::size_t count)
+{
+    if (count > max_size)
+    {
+        throw std::length_error("EventStore can't hold more than 2^32 - 1 events");
+    }
+    onsets.reserve(count);
+    durations.reserve(count);
+    pitches.reserve(count);
+    velocities.reserve(count);
+    voices.reserve(count);
+}
+
+/**
+ * @brief Empties every column, keeping their capacity
+ */
+void EventStore::clear() noexcept
+{
+    onsets.clear();
+    durations.clear();
+    pitches.clear();
+    velocities.clear();
+    voices.clear();
+    sorted = true;
+}
+
+/**
+ * @brief Returns a view of every event
+ *
+ * @details The view is invalidated by append, reserve and sortByOnset
+ *
+ * @return EventView
+ */
+EventView EventStore::view() const noexcept
+{
+    return {onsets.data(), durations.data(), pitches.data(), velocities.data(), voices.data(), onsets.size()};
+}
+
+/**
+ * @brief Returns the events of a view starting in [from, to)
+ *
+ * @details The view must be sorted by onset. Finds both ends by binary search on the
+ * onset column, so costs O(log n) and copies nothing
+ *
+ * @param events Events sorted by onset
+ * @param from First tick of the range
+ * @param to Tick one past the end of the range
+ * @return EventView
+ */
+EventView sliceByOnset(const EventView &events, std::uint32_t from, std::uint32_t to) noexcept
+{
+    if (to < from)
+    {
+        to = from;
+    }
+    const std::uint32_t *end = events.onsets + events.size;
+    std::size_t first = std::lower_bound(events.onsets, end, from) - events.onsets;
+    std::size_t last = std::lower_bound(events.onsets + first, end, to) - events.onsets;
+    return {events.onsets + first,     events.durations + first, events.pitches + first,
+            events.velocities + first, events.voices + first,    last - first};
+}
+
+/**
+ * @brief Returns the events starting in [from, to), see sliceByOnset
+ *
+ * @details Throws std::logic_error if the store isn't sorted by onset
+ *
+ * @param from First tick of the range
+ * @param to Tick one past the end of the range
+ * @return EventView
+ */
+EventView EventStore::slice(std::uint32_t from, std::uint32_t to) const
+{
+    if (!sorted)
+    {
+        throw std::logic_error("EventStore must be sorted by onset before slicing");
+    }
+    return sliceByOnset(view(), from, to);
+}
+
+/**
+ * @brief Stably sorts every column by onset
+ *
+ * @details Sorts one 64-bit key per event, the onset above the row index, so equal
+ * onsets keep their order without needing std::stable_sort's extra buffer. The other
+ * columns are then permuted in place by following the cycles of the permutation, with
+ * the top bit of each key marking rows already placed, so sorting allocates nothing
+ * once the key buffer is big enough. Does nothing if the store is already sorted.
+ * append keeps the store within max_size events, so every row index fits in 32 bits
+ */
+void EventStore::sortByOnset()
+{
+    if (sorted)
+    {
+        return;
+    }
+    const std::size_t count = onsets.size();
+    sort_keys.resize(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        sort_keys[i] = static_cast<std::uint64_t>(onsets[i]) << 32 | i;
+    }
+    std::sort(sort_keys.begin(), sort_keys.end());
+
+    // Only the row indices are needed from here on, the onsets can be written back
+    constexpr std::uint64_t placed = std::uint64_t(1) << 63;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        onsets[i] = static_cast<std::uint32_t>(sort_keys[i] >> 32);
+        sort_keys[i] &= 0xFFFFFFFF;
+    }
+    for (std::size_t start = 0; start < count; ++start)
+    {
+        if (sort_keys[start] & placed)
+        {
+            continue;
+        }
+        std::uint32_t duration = durations[start];
+        PackedPitch pitch = pitches[start];
+        std::uint8_t velocity = velocities[start];
+        std::uint16_t voice = voices[start];
+        std::size_t i = start;
+        for (std::size_t from = sort_keys[i]; from != start; from = sort_keys[i])
+        {
+            durations[i] = durations[from];
+            pitches[i] = pitches[from];
+            velocities[i] = velocities[from];
+            voices[i] = voices[from];
+            sort_keys[i] |= placed;
+            i = from;
+        }
+        durations[i] = duration;
+        pitches[i] = pitch;
+        velocities[i] = velocity;
+        voices[i] = voice;
+        sort_keys[i] |= placed;
+    }
+    sorted = true;
+}
+
+} // namespace mt
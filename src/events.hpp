@@ -0,0 +1,129 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "mt.hpp"
+
+#include <cstddef>         // std::size_t
+#include <cstdint>         // std::uint8_t, std::uint16_t, std::uint32_t
+#include <memory>          // std::unique_ptr
+#include <memory_resource> // std::pmr::memory_resource, std::pmr::vector
+
+namespace mt
+{
+
+//! Read-only view of a run of events, one pointer per column
+struct EventView
+{
+    const std::uint32_t *onsets;    //!< Start of each event in ticks
+    const std::uint32_t *durations; //!< Length of each event in ticks
+    const PackedPitch *pitches;
+    const std::uint8_t *velocities;
+    const std::uint16_t *voices;
+    std::size_t size;
+};
+
+EventView sliceByOnset(const EventView &events, std::uint32_t from, std::uint32_t to) noexcept;
+
+//! Timed note events stored as separate contiguous columns allocated from an arena
+/*!
+  Each column is a std::pmr::vector drawing from one memory resource, by default a
+  monotonic arena owned by the store, so building a store never touches the general
+  heap beyond the arena's own blocks and all of it is released at once. Analysis
+  passes read one column at a time and stream through memory linearly.
+
+  Pass a resource to share one arena between several stores; it must outlive them.
+  Appending in onset order keeps the store sorted, which slice needs; otherwise call
+  sortByOnset first.
+*/
+class EventStore
+{
+  public:
+    explicit EventStore(std::pmr::memory_resource *resource = nullptr);
+    //! The columns keep their arena, a moved-from store may only be destroyed
+    EventStore(EventStore &&other) noexcept = default;
+    EventStore &operator=(EventStore &&) = delete;
+    EventStore(const EventStore &) = delete;
+    EventStore &operator=(const EventStore &) = delete;
+
+    //! Most events a store holds, as sortByOnset keeps row indices in 32 bits
+    static constexpr std::size_t max_size = 0xFFFFFFFF;
+
+    void append(std::uint32_t onset, std::uint32_t duration, PackedPitch pitch, std::uint8_t velocity = 80,
+                std::uint16_t voice = 0);
+    void reserve(std::size_t count);
+    void clear() noexcept;
+
+    std::size_t size() const noexcept
+    {
+        return onsets.size();
+    }
+    bool empty() const noexcept
+    {
+        return onsets.empty();
+    }
+    bool isSorted() const noexcept
+    {
+        return sorted;
+    }
+
+    const std::uint32_t *getOnsets() const noexcept
+    {
+        return onsets.data();
+    }
+    const std::uint32_t *getDurations() const noexcept
+    {
+        return durations.data();
+    }
+    const PackedPitch *getPitches() const noexcept
+    {
+        return pitches.data();
+    }
+    const std::uint8_t *getVelocities() const noexcept
+    {
+        return velocities.data();
+    }
+    const std::uint16_t *getVoices() const noexcept
+    {
+        return voices.data();
+    }
+
+    EventView view() const noexcept;
+    EventView slice(std::uint32_t from, std::uint32_t to) const;
+    void sortByOnset();
+
+  private:
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> owned_arena;
+    std::pmr::memory_resource *arena;
+    std::pmr::vector<std::uint32_t> onsets;
+    std::pmr::vector<std::uint32_t> durations;
+    std::pmr::vector<PackedPitch> pitches;
+    std::pmr::vector<std::uint8_t> velocities;
+    std::pmr::vector<std::uint16_t> voices;
+    std::pmr::vector<std::uint64_t> sort_keys; //!< Kept so repeated sorts don't grow the arena
+    bool sorted = true;
+};
+
+} // namespace mt
@@ -0,0 +1,182 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "mapped_file.hpp"
+
+#include <cerrno>       // errno
+#include <fstream>      // std::ifstream
+#include <system_error> // std::system_error
+#include <utility>      // std::swap
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MT_HAS_MMAP 1
+#include <fcntl.h>    // open
+#include <sys/mman.h> // mmap, madvise, munmap
+#include <sys/stat.h> // fstat
+#include <unistd.h>   // close, write
+#endif
+
+namespace mt
+{
+
+/**
+ * @brief Maps a whole file for reading
+ *
+ * @details Falls back on reading the file into memory where mmap isn't available.
+ * Throws std::system_error if the file can't be opened or mapped
+ *
+ * @param path File to map
+ */
+MappedFile::MappedFile(const std::string &path)
+{
+#ifdef MT_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Couldn't open " + path);
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0)
+    {
+        int error = errno;
+        ::close(fd);
+        throw std::system_error(error, std::generic_category(), "Couldn't stat " + path);
+    }
+    length = static_cast<std::size_t>(info.st_size);
+    if (length > 0)
+    {
+        void *address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED)
+        {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Couldn't map " + path);
+        }
+        ::madvise(address, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const std::uint8_t *>(address);
+        mapped = true;
+    }
+    ::close(fd);
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+    {
+        throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory), "Couldn't open " + path);
+    }
+    length = static_cast<std::size_t>(in.tellg());
+    std::uint8_t *buffer = new std::uint8_t[length ? length : 1];
+    in.seekg(0);
+    in.read(reinterpret_cast<char *>(buffer), static_cast<std::streamsize>(length));
+    bytes = buffer;
+#endif
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : bytes(other.bytes), length(other.length), mapped(other.mapped)
+{
+    other.bytes = nullptr;
+    other.length = 0;
+    other.mapped = false;
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    std::swap(bytes, other.bytes);
+    std::swap(length, other.length);
+    std::swap(mapped, other.mapped);
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    release();
+}
+
+void MappedFile::release() noexcept
+{
+#ifdef MT_HAS_MMAP
+    if (mapped)
+    {
+        ::munmap(const_cast<std::uint8_t *>(bytes), length);
+    }
+    else
+#endif
+    {
+        delete[] bytes;
+    }
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+}
+
+/**
+ * @brief Replaces the contents of a file with one buffer
+ *
+ * @details A single write call for the whole buffer unless the OS returns early.
+ * Throws std::system_error if the file can't be created or written
+ *
+ * @param path File to create or truncate
+ * @param data Bytes to write
+ * @param size Number of bytes
+ */
+void writeWholeFile(const std::string &path, const void *data, std::size_t size)
+{
+#ifdef MT_HAS_MMAP
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Couldn't create " + path);
+    }
+    const char *p = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t written = ::write(fd, p, size);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written < 0)
+        {
+            int error = errno;
+            ::close(fd);
+            throw std::system_error(error, std::generic_category(), "Couldn't write " + path);
+        }
+        p += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    if (::close(fd) != 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Couldn't write " + path);
+    }
+#else
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+    if (!out)
+    {
+        throw std::system_error(std::make_error_code(std::errc::io_error), "Couldn't write " + path);
+    }
+#endif
+}
+
+} // namespace mt
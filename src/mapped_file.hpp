@@ -0,0 +1,69 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef> // std::size_t
+#include <cstdint> // std::uint8_t
+#include <string>  // std::string
+
+namespace mt
+{
+
+//! Read-only view of a whole file, memory-mapped where the platform allows
+/*!
+  Pages are only read in as they are touched, and the mapping is hinted for
+  sequential access. Throws std::system_error if the file can't be opened or mapped.
+  Move-only; the view stays valid for as long as the MappedFile lives.
+*/
+class MappedFile
+{
+  public:
+    explicit MappedFile(const std::string &path);
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    const std::uint8_t *data() const noexcept
+    {
+        return bytes;
+    }
+    std::size_t size() const noexcept
+    {
+        return length;
+    }
+
+  private:
+    void release() noexcept;
+
+    const std::uint8_t *bytes = nullptr;
+    std::size_t length = 0;
+    bool mapped = false; //!< false when bytes is null, for an empty file, or came from new[] without mmap
+};
+
+void writeWholeFile(const std::string &path, const void *data, std::size_t size);
+
+} // namespace mt
@@ -0,0 +1,555 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "midi.hpp"
+#include "mapped_file.hpp"
+
+#include <algorithm> // std::sort
+#include <cstring>   // std::memcmp
+
+namespace mt
+{
+
+/**
+ * @brief Empties every column, keeping their capacity
+ */
+void MidiNotes::clear() noexcept
+{
+    ticks.clear();
+    durations.clear();
+    tracks.clear();
+    channels.clear();
+    notes.clear();
+    velocities.clear();
+}
+
+/**
+ * @brief Reserves room for count notes in every column
+ *
+ * @param count Number of notes
+ */
+void MidiNotes::reserve(std::size_t count)
+{
+    ticks.reserve(count);
+    durations.reserve(count);
+    tracks.reserve(count);
+    channels.reserve(count);
+    notes.reserve(count);
+    velocities.reserve(count);
+}
+
+/**
+ * @brief Appends one note to every column
+ *
+ * @details Throws MidiFileException if the note, velocity or channel is out of range,
+ * or if the note would end past 2^32 ticks
+ *
+ * @param tick Onset in ticks
+ * @param duration Length in ticks
+ * @param note MIDI note number, 0 to 127
+ * @param velocity 1 to 127
+ * @param channel 0 to 15
+ * @param track Track to write the note to, see MidiWriter
+ */
+void MidiNotes::append(std::uint32_t tick, std::uint32_t duration, std::uint8_t note, std::uint8_t velocity,
+                       std::uint8_t channel, std::uint16_t track)
+{
+    if (note > 127 || velocity == 0 || velocity > 127 || channel > 15)
+    {
+        throw MidiFileException("Invalid MIDI note: note, velocity or channel out of range");
+    }
+    if (duration > 0xFFFFFFFFu - tick)
+    {
+        throw MidiFileException("Invalid MIDI note: ends past 2^32 ticks");
+    }
+    ticks.push_back(tick);
+    durations.push_back(duration);
+    tracks.push_back(track);
+    channels.push_back(channel);
+    notes.push_back(note);
+    velocities.push_back(velocity);
+}
+
+namespace
+{
+
+[[noreturn]] void fail(const char *what, std::size_t offset)
+{
+    std::string message = std::string("Invalid MIDI file: ") + what + " at byte " + std::to_string(offset);
+    throw MidiFileException(message.c_str());
+}
+
+std::uint32_t readBigEndian(const std::uint8_t *p, int bytes)
+{
+    std::uint32_t value = 0;
+    for (int i = 0; i < bytes; ++i)
+    {
+        value = value << 8 | p[i];
+    }
+    return value;
+}
+
+//! Decodes the events of one MTrk chunk, appending its notes to the columns
+/*!
+  Note ons are matched to note offs first in, first out per channel and note. While a
+  note is open its durations entry links to the next open note of the same key, so the
+  matching needs no memory beyond two small tables.
+*/
+class TrackDecoder
+{
+  public:
+    TrackDecoder(const std::uint8_t *file_start, MidiNotes &notes) : start(file_start), columns(notes)
+    {
+    }
+
+    void decode(const std::uint8_t *p, const std::uint8_t *end, std::uint16_t track)
+    {
+        for (std::uint32_t &index : heads)
+        {
+            index = none;
+        }
+        std::uint64_t tick = 0;
+        std::uint8_t running_status = 0;
+        while (p < end)
+        {
+            tick += readVariableLength(p, end);
+            if (tick > 0xFFFFFFFFu)
+            {
+                fail("track longer than 2^32 ticks", offset(p));
+            }
+            if (p == end)
+            {
+                fail("missing event after delta time", offset(p));
+            }
+
+            std::uint8_t status = *p;
+            if (status & 0x80)
+            {
+                ++p;
+            }
+            else if (running_status != 0)
+            {
+                status = running_status;
+            }
+            else
+            {
+                fail("data byte without running status", offset(p));
+            }
+
+            if (status < 0xF0)
+            {
+                running_status = status;
+                unsigned type = status >> 4;
+                int length = type == 0xC || type == 0xD ? 1 : 2;
+                if (end - p < length)
+                {
+                    fail("truncated channel message", offset(p));
+                }
+                if ((p[0] | p[length - 1]) & 0x80)
+                {
+                    fail("status byte inside a channel message", offset(p));
+                }
+                unsigned key = (status & 0xF) << 7 | p[0];
+                if (type == 0x9 && p[1] != 0)
+                {
+                    open(key, static_cast<std::uint32_t>(tick), track, p[1]);
+                }
+                else if (type == 0x8 || type == 0x9)
+                {
+                    close(key, static_cast<std::uint32_t>(tick));
+                }
+                p += length;
+            }
+            else if (status == 0xFF || status == 0xF0 || status == 0xF7)
+            {
+                running_status = 0;
+                std::uint8_t meta_type = 0;
+                if (status == 0xFF)
+                {
+                    if (p == end)
+                    {
+                        fail("truncated meta event", offset(p));
+                    }
+                    meta_type = *p++;
+                }
+                std::uint32_t length = readVariableLength(p, end);
+                if (static_cast<std::size_t>(end - p) < length)
+                {
+                    fail("truncated meta or sysex event", offset(p));
+                }
+                p += length;
+                if (status == 0xFF && meta_type == 0x2F)
+                {
+                    break; // End of track
+                }
+            }
+            else
+            {
+                fail("unexpected system message in a track", offset(p - 1));
+            }
+        }
+        closeAll(static_cast<std::uint32_t>(tick));
+    }
+
+  private:
+    static constexpr std::uint32_t none = 0xFFFFFFFF;
+
+    std::size_t offset(const std::uint8_t *p) const
+    {
+        return static_cast<std::size_t>(p - start);
+    }
+
+    std::uint32_t readVariableLength(const std::uint8_t *&p, const std::uint8_t *end) const
+    {
+        std::uint32_t value = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            if (p == end)
+            {
+                fail("truncated variable length quantity", offset(p));
+            }
+            std::uint8_t byte = *p++;
+            value = value << 7 | (byte & 0x7F);
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        fail("variable length quantity over 4 bytes", offset(p));
+    }
+
+    void open(unsigned key, std::uint32_t tick, std::uint16_t track, std::uint8_t velocity)
+    {
+        auto row = static_cast<std::uint32_t>(columns.notes.size());
+        columns.ticks.push_back(tick);
+        columns.durations.push_back(none);
+        columns.tracks.push_back(track);
+        columns.channels.push_back(static_cast<std::uint8_t>(key >> 7));
+        columns.notes.push_back(static_cast<std::uint8_t>(key & 0x7F));
+        columns.velocities.push_back(velocity);
+        if (heads[key] == none)
+        {
+            heads[key] = row;
+        }
+        else
+        {
+            columns.durations[tails[key]] = row;
+        }
+        tails[key] = row;
+    }
+
+    void close(unsigned key, std::uint32_t tick)
+    {
+        std::uint32_t row = heads[key];
+        if (row == none)
+        {
+            return; // Note off without a note on, ignored like most players do
+        }
+        heads[key] = columns.durations[row];
+        columns.durations[row] = tick - columns.ticks[row];
+    }
+
+    //! Notes still sounding at the end of the track last until then
+    void closeAll(std::uint32_t tick)
+    {
+        for (unsigned key = 0; key < 16 * 128; ++key)
+        {
+            while (heads[key] != none)
+            {
+                close(key, tick);
+            }
+        }
+    }
+
+    const std::uint8_t *start;
+    MidiNotes &columns;
+    std::uint32_t heads[16 * 128]; //!< Oldest open note per channel and note, or none
+    std::uint32_t tails[16 * 128]; //!< Newest open note per channel and note, valid while heads isn't none
+};
+
+} // namespace
+
+/**
+ * @brief Decodes a format 0 or 1 Standard MIDI File held in memory
+ *
+ * @details Handles running status, meta and sysex events, note ons with velocity 0
+ * as note offs, and unknown chunks, which are skipped. Reuses the capacity of
+ * file.notes, so no allocation happens once the columns are big enough. Throws
+ * MidiFileException, giving the byte offset, if the data isn't a valid file
+ *
+ * @param data Bytes of the file
+ * @param size Number of bytes
+ * @param file Receives the header fields and notes
+ */
+void parseMidi(const std::uint8_t *data, std::size_t size, MidiFile &file)
+{
+    file.notes.clear();
+    if (size < 14 || std::memcmp(data, "MThd", 4) != 0)
+    {
+        fail("missing MThd header", 0);
+    }
+    std::uint32_t header_length = readBigEndian(data + 4, 4);
+    if (header_length < 6 || header_length > size - 8)
+    {
+        fail("bad MThd length", 4);
+    }
+    file.format = static_cast<std::uint16_t>(readBigEndian(data + 8, 2));
+    file.track_count = static_cast<std::uint16_t>(readBigEndian(data + 10, 2));
+    file.division = static_cast<std::uint16_t>(readBigEndian(data + 12, 2));
+    if (file.format > 1)
+    {
+        fail("only formats 0 and 1 are supported", 8);
+    }
+
+    TrackDecoder decoder(data, file.notes);
+    std::size_t position = 8 + header_length;
+    std::uint16_t track = 0;
+    while (size - position >= 8)
+    {
+        const std::uint8_t *chunk = data + position;
+        std::uint32_t length = readBigEndian(chunk + 4, 4);
+        if (length > size - position - 8)
+        {
+            fail("chunk runs past the end of the file", position);
+        }
+        if (std::memcmp(chunk, "MTrk", 4) == 0)
+        {
+            decoder.decode(chunk + 8, chunk + 8 + length, track++);
+        }
+        position += 8 + length;
+    }
+}
+
+/**
+ * @brief Decodes a Standard MIDI File held in memory, see parseMidi(const std::uint8_t *, std::size_t, MidiFile &)
+ *
+ * @param data Bytes of the file
+ * @param size Number of bytes
+ * @return MidiFile
+ */
+MidiFile parseMidi(const std::uint8_t *data, std::size_t size)
+{
+    MidiFile file;
+    parseMidi(data, size, file);
+    return file;
+}
+
+/**
+ * @brief Memory-maps and decodes a Standard MIDI File
+ *
+ * @details Throws std::system_error if the file can't be opened or mapped, and
+ * MidiFileException if it isn't a valid file
+ *
+ * @param path File to read
+ * @param file Receives the header fields and notes, reusing its capacity
+ */
+void readMidiFile(const std::string &path, MidiFile &file)
+{
+    MappedFile mapped(path);
+    parseMidi(mapped.data(), mapped.size(), file);
+}
+
+/**
+ * @brief Memory-maps and decodes a Standard MIDI File, see readMidiFile(const std::string &, MidiFile &)
+ *
+ * @param path File to read
+ * @return MidiFile
+ */
+MidiFile readMidiFile(const std::string &path)
+{
+    MidiFile file;
+    readMidiFile(path, file);
+    return file;
+}
+
+namespace
+{
+
+//! Event sort key: time, then offs of sounding notes, ons, offs of zero length notes, then row
+constexpr std::uint64_t eventKey(std::uint64_t time, unsigned kind, std::size_t row)
+{
+    return time << 32 | static_cast<std::uint64_t>(kind) << 30 | row;
+}
+
+constexpr unsigned note_off = 0;
+constexpr unsigned note_on = 1;
+constexpr unsigned zero_length_note_off = 2;
+constexpr std::size_t max_rows = std::size_t(1) << 30;
+
+std::uint8_t *writeBigEndian(std::uint8_t *p, std::uint32_t value, int bytes)
+{
+    for (int shift = 8 * (bytes - 1); shift >= 0; shift -= 8)
+    {
+        *p++ = static_cast<std::uint8_t>(value >> shift);
+    }
+    return p;
+}
+
+std::uint8_t *writeVariableLength(std::uint8_t *p, std::uint32_t value)
+{
+    if (value >= 1u << 21)
+    {
+        *p++ = static_cast<std::uint8_t>(0x80 | value >> 21);
+    }
+    if (value >= 1u << 14)
+    {
+        *p++ = static_cast<std::uint8_t>(0x80 | (value >> 14 & 0x7F));
+    }
+    if (value >= 1u << 7)
+    {
+        *p++ = static_cast<std::uint8_t>(0x80 | (value >> 7 & 0x7F));
+    }
+    *p++ = static_cast<std::uint8_t>(value & 0x7F);
+    return p;
+}
+
+} // namespace
+
+/**
+ * @brief Encodes notes into a Standard MIDI File held by the writer
+ *
+ * @details Notes may come in any order. Each distinct value of the tracks column
+ * becomes an MTrk chunk, so the file is format 0 if every note is on track 0 and
+ * format 1 otherwise. Note offs are written as velocity 0 note ons so running status
+ * covers every event of a channel. The buffer is sized for the worst case up front
+ * and written in one pass. Throws MidiFileException if a gap between events doesn't
+ * fit a variable length quantity or there are more than 2^30 notes
+ *
+ * @param notes Notes to encode
+ * @param division Ticks per quarter note
+ * @return const std::vector<std::uint8_t>& Encoded file, valid until the next call
+ */
+const std::vector<std::uint8_t> &MidiWriter::encode(const MidiNotes &notes, std::uint16_t division)
+{
+    std::size_t count = notes.size();
+    if (count > max_rows)
+    {
+        throw MidiFileException("Invalid MIDI file: too many notes to encode");
+    }
+
+    // Counting sort of the rows by track, then one sort of event keys per track
+    std::size_t track_count = 1;
+    for (std::uint16_t track : notes.tracks)
+    {
+        track_count = std::max<std::size_t>(track_count, track + 1u);
+    }
+    track_starts.assign(track_count + 1, 0);
+    for (std::uint16_t track : notes.tracks)
+    {
+        track_starts[track + 1] += 2;
+    }
+    for (std::size_t track = 0; track < track_count; ++track)
+    {
+        track_starts[track + 1] += track_starts[track];
+    }
+    events.resize(2 * count);
+    for (std::size_t row = 0; row < count; ++row)
+    {
+        // track_starts[t] moves along track t as its events are placed, ending on the start of track t + 1
+        std::uint64_t start = notes.ticks[row];
+        std::uint64_t end = start + notes.durations[row];
+        std::size_t &cursor = track_starts[notes.tracks[row]];
+        events[cursor++] = eventKey(start, note_on, row);
+        events[cursor++] = eventKey(end, notes.durations[row] ? note_off : zero_length_note_off, row);
+    }
+    for (std::size_t track = track_count; track > 0; --track)
+    {
+        track_starts[track] = track_starts[track - 1];
+    }
+    track_starts[0] = 0;
+
+    // 14 byte header, 8 bytes per track chunk plus 4 for end of track, at most 7 bytes per event
+    buffer.resize(14 + 12 * track_count + 7 * events.size());
+    std::uint8_t *p = buffer.data();
+    p = writeBigEndian(p, 0x4D546864, 4); // MThd
+    p = writeBigEndian(p, 6, 4);
+    p = writeBigEndian(p, track_count > 1 ? 1 : 0, 2);
+    p = writeBigEndian(p, static_cast<std::uint32_t>(track_count), 2);
+    p = writeBigEndian(p, division, 2);
+    for (std::size_t track = 0; track < track_count; ++track)
+    {
+        auto first = events.begin() + static_cast<std::ptrdiff_t>(track_starts[track]);
+        auto last = events.begin() + static_cast<std::ptrdiff_t>(track_starts[track + 1]);
+        std::sort(first, last);
+
+        p = writeBigEndian(p, 0x4D54726B, 4); // MTrk
+        std::uint8_t *length = p;
+        p += 4;
+        std::uint64_t time = 0;
+        unsigned running_status = 0;
+        for (auto event = first; event != last; ++event)
+        {
+            std::uint64_t event_time = *event >> 32;
+            auto row = static_cast<std::size_t>(*event & (max_rows - 1));
+            if (event_time - time > 0x0FFFFFFF)
+            {
+                throw MidiFileException("Invalid MIDI file: gap between events over 2^28 ticks");
+            }
+            p = writeVariableLength(p, static_cast<std::uint32_t>(event_time - time));
+            time = event_time;
+            unsigned status = 0x90 | notes.channels[row];
+            if (status != running_status)
+            {
+                *p++ = static_cast<std::uint8_t>(status);
+                running_status = status;
+            }
+            *p++ = notes.notes[row];
+            *p++ = (*event >> 30 & 0x3) == note_on ? notes.velocities[row] : 0;
+        }
+        p = writeBigEndian(p, 0x00FF2F00, 4); // End of track
+        writeBigEndian(length, static_cast<std::uint32_t>(p - length - 4), 4);
+    }
+    buffer.resize(static_cast<std::size_t>(p - buffer.data()));
+    return buffer;
+}
+
+/**
+ * @brief Encodes notes and writes them to a file with a single write
+ *
+ * @details See encode. Throws std::system_error if the file can't be written
+ *
+ * @param path File to create or truncate
+ * @param notes Notes to encode
+ * @param division Ticks per quarter note
+ */
+void MidiWriter::write(const std::string &path, const MidiNotes &notes, std::uint16_t division)
+{
+    encode(notes, division);
+    writeWholeFile(path, buffer.data(), buffer.size());
+}
+
+/**
+ * @brief Writes notes to a Standard MIDI File, see MidiWriter::encode
+ *
+ * @param path File to create or truncate
+ * @param notes Notes to encode
+ * @param division Ticks per quarter note
+ */
+void writeMidiFile(const std::string &path, const MidiNotes &notes, std::uint16_t division)
+{
+    MidiWriter writer;
+    writer.write(path, notes, division);
+}
+
+} // namespace mt
@@ -0,0 +1,117 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "mt.hpp"
+
+#include <cstddef>   // std::size_t
+#include <cstdint>   // std::uint8_t, std::uint16_t, std::uint32_t
+#include <stdexcept> // std::runtime_error
+#include <string>    // std::string
+#include <vector>    // std::vector
+
+namespace mt
+{
+
+//! Exception for when a Standard MIDI File can't be read or written
+class MidiFileException : public std::runtime_error
+{
+  public:
+    MidiFileException(char const *const message) throw() : std::runtime_error(message)
+    {
+    }
+};
+
+//! Notes of a Standard MIDI File as struct-of-arrays columns, one row per note
+/*!
+  Rows are grouped by track, and in onset order within a track. The notes column
+  holds MIDI values ready for PackedPitch::fromMidi, Pitch(unsigned short) or
+  midiToFrequencies. Clearing keeps the capacity, so one MidiNotes can be reused
+  across files without allocating once it has grown.
+*/
+struct MidiNotes
+{
+    std::vector<std::uint32_t> ticks;     //!< Onset in ticks from the start of the track
+    std::vector<std::uint32_t> durations; //!< Ticks until the matching note off
+    std::vector<std::uint16_t> tracks;    //!< Index of the MTrk chunk the note came from
+    std::vector<std::uint8_t> channels;   //!< 0 to 15
+    std::vector<std::uint8_t> notes;      //!< MIDI note number, 0 to 127
+    std::vector<std::uint8_t> velocities; //!< Note on velocity, 1 to 127
+
+    std::size_t size() const noexcept
+    {
+        return notes.size();
+    }
+    void clear() noexcept;
+    void reserve(std::size_t count);
+    void append(std::uint32_t tick, std::uint32_t duration, std::uint8_t note, std::uint8_t velocity = 80,
+                std::uint8_t channel = 0, std::uint16_t track = 0);
+    //! Appends a pitch, which must be in the MIDI range
+    void append(std::uint32_t tick, std::uint32_t duration, PackedPitch pitch, std::uint8_t velocity = 80,
+                std::uint8_t channel = 0, std::uint16_t track = 0)
+    {
+        append(tick, duration, static_cast<std::uint8_t>(pitch.getMidiValue()), velocity, channel, track);
+    }
+    //! Spelled pitch of row i
+    PackedPitch getPitch(std::size_t i, bool use_sharps = true) const noexcept
+    {
+        return PackedPitch::fromMidi(notes[i], use_sharps);
+    }
+};
+
+//! Header information and notes of a Standard MIDI File
+struct MidiFile
+{
+    std::uint16_t format = 0;      //!< 0 or 1
+    std::uint16_t track_count = 0; //!< Number of MTrk chunks
+    std::uint16_t division = 0;    //!< Ticks per quarter note, or SMPTE timing if the top bit is set
+    MidiNotes notes;
+};
+
+void parseMidi(const std::uint8_t *data, std::size_t size, MidiFile &file);
+MidiFile parseMidi(const std::uint8_t *data, std::size_t size);
+void readMidiFile(const std::string &path, MidiFile &file);
+MidiFile readMidiFile(const std::string &path);
+
+//! Encodes MidiNotes columns into Standard MIDI Files
+/*!
+  Keeps its output buffer and sort scratch between calls, so encoding file after
+  file with one MidiWriter stops allocating once they have grown.
+*/
+class MidiWriter
+{
+  public:
+    const std::vector<std::uint8_t> &encode(const MidiNotes &notes, std::uint16_t division = 480);
+    void write(const std::string &path, const MidiNotes &notes, std::uint16_t division = 480);
+
+  private:
+    std::vector<std::uint8_t> buffer;
+    std::vector<std::uint64_t> events;
+    std::vector<std::size_t> track_starts;
+};
+
+void writeMidiFile(const std::string &path, const MidiNotes &notes, std::uint16_t division = 480);
+
+} // namespace mt
@@ -24,35 +24,24 @@
 
 #include "mt.hpp"
 
-namespace mt
-{
+#include <algorithm> // std::min, std::max
+#include <cstdlib>   // std::abs
+#include <cstring>   // std::memcpy
+#include <limits>    // std::numeric_limits
 
-/**
- * @brief Construct a new Key object
- *
- * @param t Type of Key (A, B, C, etc)
- */
-Key::Key(Key::Type t)
-{
-    type = t;
-}
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h> // _mm_cmpeq_epi8, _mm256_cmpeq_epi8, ...
+#endif
 
-/**
- * @brief Returns the type of the Key
- *
- * @return Key::Type
- */
-Key::Type Key::getType()
+namespace mt
 {
-    return type;
-}
 
 /**
  * @brief Returns a string pertaining to the Key's name
  *
  * @return std::string 1 letter string of the key's name
  */
-std::string Key::toString()
+std::string Key::toString() const
 {
     switch (type)
     {
@@ -75,25 +64,20 @@ std::string Key::toString()
 }
 
 /**
- * @brief Construct a new Accidental object
- *
- * @details Default constructor gives natural
- *
- * @param t Type of accidental
- */
-Accidental::Accidental(Accidental::Type t)
-{
-    type = t;
-}
-
-/**
- * @brief Gives type of an Accidental
+ * @brief Writes the Key's name into [first, last) without allocating
  *
- * @return Accidental::Type natural, sharp, flat, etc
+ * @param first Start of the output buffer
+ * @param last One past the end of the output buffer
+ * @return std::to_chars_result ec is std::errc::value_too_large if the buffer is too small
  */
-Accidental::Type Accidental::getType()
+std::to_chars_result Key::toChars(char *first, char *last) const noexcept
 {
-    return type;
+    if (last - first < 1)
+    {
+        return {last, std::errc::value_too_large};
+    }
+    *first = "ABCDEFG"[static_cast<int>(type)];
+    return {first + 1, std::errc()};
 }
 
 /**
@@ -103,7 +87,7 @@ Accidental::Type Accidental::getType()
  *
  * @return std::string
  */
-std::string Accidental::toString()
+std::string Accidental::toString() const
 {
     switch (type)
     {
@@ -122,17 +106,28 @@ std::string Accidental::toString()
 }
 
 /**
- * @brief Construct a new Pitch:: Pitch object
+ * @brief Writes the Accidental's symbol into [first, last) without allocating
  *
- * @param k Key
- * @param a Accidental
- * @param o octave
+ * @details Writes nothing if natural
+ *
+ * @param first Start of the output buffer
+ * @param last One past the end of the output buffer
+ * @return std::to_chars_result ec is std::errc::value_too_large if the buffer is too small
  */
-Pitch::Pitch(Key k, Accidental a, unsigned short o)
+std::to_chars_result Accidental::toChars(char *first, char *last) const noexcept
 {
-    key = k;
-    accidental = a;
-    octave = o;
+    static const char symbols[][3] = {"", "b", "#", "bb", "##"};
+    const char *symbol = symbols[static_cast<int>(type)];
+    std::ptrdiff_t length = type == Type::natural ? 0 : (type == Type::flat || type == Type::sharp) ? 1 : 2;
+    if (last - first < length)
+    {
+        return {last, std::errc::value_too_large};
+    }
+    for (std::ptrdiff_t i = 0; i < length; ++i)
+    {
+        first[i] = symbol[i];
+    }
+    return {first + length, std::errc()};
 }
 
 /**
@@ -144,520 +139,905 @@ Pitch::Pitch(Key k, Accidental a, unsigned short o)
  */
 Pitch::Pitch(std::string val)
 {
-    std::string error_string = "Failed to parse note: " + val;
-
-    if (val.length() < 2 || val.length() > 4)
+    PackedPitch p;
+    auto result = parsePitch(val, p);
+    if (result.ec != std::errc() || result.ptr != val.data() + val.size())
     {
+        std::string error_string = "Failed to parse note: " + val;
         throw PitchParsingException(error_string.c_str());
     }
+    key = Key(p.getKeyType());
+    accidental = Accidental(p.getAccidentalType());
+    octave = p.getOctave();
+}
 
-    // Deal with Key value
-    auto fc = val.at(0);
+/**
+ * @brief Construct a Pitch object
+ *
+ * @details Will throw PitchParsingException if midi value is out of range.
+ * Spellings come from a precomputed table covering MIDI 0 (C-1) to 127 (G9)
+ *
+ * @param midi_value valid MIDI value
+ * @param use_sharps choose whether to use sharps for flats for accidentals
+ */
+Pitch::Pitch(unsigned short midi_value, bool use_sharps)
+{
+    if (midi_value > 127)
+    {
+        std::string error_message = "Couldn't parse midi value to note: " + std::to_string(midi_value);
+        throw PitchParsingException(error_message.c_str());
+    }
+
+    PackedPitch p = PackedPitch::fromMidi(static_cast<std::uint8_t>(midi_value), use_sharps);
+    key = Key(p.getKeyType());
+    accidental = Accidental(p.getAccidentalType());
+    octave = p.getOctave();
+}
+
+/**
+ * @brief Returns the Pitch string, i.e "Bb3"
+ *
+ * @return std::string Key Accidental Octave i.e "C#4"
+ */
+std::string Pitch::toString() const
+{
+    char buffer[16];
+    auto result = toChars(buffer, buffer + sizeof(buffer));
+    return std::string(buffer, result.ptr);
+}
 
-    if (fc >= 'a' && fc <= 'g')
+/**
+ * @brief Writes the Pitch string, i.e "Bb3", into [first, last) without allocating
+ *
+ * @param first Start of the output buffer
+ * @param last One past the end of the output buffer
+ * @return std::to_chars_result ec is std::errc::value_too_large if the buffer is too small
+ */
+std::to_chars_result Pitch::toChars(char *first, char *last) const noexcept
+{
+    if (octave >= -1 && octave <= 14)
     {
-        key = Key((Key::Type)(fc - 'a'));
+        return PackedPitch(*this).toChars(first, last);
     }
-    else if (fc >= 'A' && fc <= 'G')
+
+    auto result = key.toChars(first, last);
+    if (result.ec == std::errc())
     {
-        key = Key((Key::Type)(fc - 'A'));
+        result = accidental.toChars(result.ptr, last);
     }
-    else
+    if (result.ec == std::errc())
     {
-        throw PitchParsingException(error_string.c_str());
+        result = std::to_chars(result.ptr, last, octave);
+    }
+    return result;
+}
+
+/**
+ * @brief Writes the Pitch string, i.e "Bb3", into [first, last) without allocating
+ *
+ * @param first Start of the output buffer
+ * @param last One past the end of the output buffer
+ * @return std::to_chars_result ec is std::errc::value_too_large if the buffer is too small
+ */
+std::to_chars_result PackedPitch::toChars(char *first, char *last) const
+{
+    const detail::PitchName &name = detail::pitch_names.names[bits & 0x3FF];
+    if (last - first < name.length)
+    {
+        return {last, std::errc::value_too_large};
     }
+    std::memcpy(first, name.text, name.length);
+    return {first + name.length, std::errc()};
+}
 
-    // Deal with Octave value
-    auto lc = val.back();
+/**
+ * @brief Parses a Pitch string such as "C#4" from the start of [first, last)
+ *
+ * @details Accepts a key letter (either case), an optional "b", "bb", "#" or "##"
+ * and a single octave digit or -1. Never allocates or throws; on failure ec is
+ * std::errc::invalid_argument, ptr is first and value is left untouched.
+ *
+ * @param first Start of the characters to parse
+ * @param last One past the end of the characters to parse
+ * @param value Receives the parsed pitch on success
+ * @return std::from_chars_result ptr points one past the last character consumed
+ */
+std::from_chars_result parsePitch(const char *first, const char *last, PackedPitch &value) noexcept
+{
+    const char *it = first;
+    if (it == last)
+    {
+        return {first, std::errc::invalid_argument};
+    }
 
-    if (lc >= '0' && lc <= '9')
+    // Deal with Key value
+    unsigned key;
+    if (*it >= 'a' && *it <= 'g')
+    {
+        key = *it - 'a';
+    }
+    else if (*it >= 'A' && *it <= 'G')
     {
-        octave = lc - '0';
+        key = *it - 'A';
     }
     else
     {
-        throw PitchParsingException(error_string.c_str());
+        return {first, std::errc::invalid_argument};
     }
+    ++it;
 
     // Deal with accidentals
-
-    if (val.length() > 2)
+    auto accidental = Accidental::Type::natural;
+    if (it != last && (*it == 'b' || *it == '#'))
     {
-        auto fb = val.find_first_of('b');
-        auto fs = val.find_first_of('#');
-        if (fb == std::string::npos && fs == std::string::npos)
+        bool flat = *it == 'b';
+        bool twice = ++it != last && *it == it[-1];
+        if (twice)
+        {
+            ++it;
+        }
+        if (flat)
         {
-            throw PitchParsingException(error_string.c_str());
+            accidental = twice ? Accidental::Type::double_flat : Accidental::Type::flat;
         }
         else
         {
-            if (val.length() > 3)
-            {
-                if (fb != std::string::npos)
-                {
-                    if (val.find_first_of('b', fb + 1) != std::string::npos)
-                    {
-                        accidental = Accidental(Accidental::Type::double_flat);
-                    }
-                    else
-                    {
-                        throw PitchParsingException(error_string.c_str());
-                    }
-                }
-                else
-                {
-                    if (val.find_first_of('#', fs + 1) != std::string::npos)
-                    {
-                        accidental = Accidental(Accidental::Type::double_sharp);
-                    }
-                    else
-                    {
-                        throw PitchParsingException(error_string.c_str());
-                    }
-                }
-            }
-            else
-            {
-                if (fb != std::string::npos)
-                {
-                    accidental = Accidental(Accidental::Type::flat);
-                }
-                else
-                {
-                    accidental = Accidental(Accidental::Type::sharp);
-                }
-            }
+            accidental = twice ? Accidental::Type::double_sharp : Accidental::Type::sharp;
         }
     }
+
+    // Deal with Octave value, -1 holds the lowest MIDI values
+    short octave;
+    if (it != last && *it >= '0' && *it <= '9')
+    {
+        octave = static_cast<short>(*it - '0');
+        ++it;
+    }
+    else if (last - it >= 2 && it[0] == '-' && it[1] == '1')
+    {
+        octave = -1;
+        it += 2;
+    }
     else
     {
-        accidental = Accidental();
+        return {first, std::errc::invalid_argument};
     }
+    value = PackedPitch(static_cast<Key::Type>(key), accidental, octave);
+    return {it, std::errc()};
 }
 
 /**
- * @brief Construct a Pitch object
- *
- * @details Will throw PitchParsingException if midi value is out of range
+ * @brief Parses a Pitch string such as "C#4" from the start of a string_view
  *
- * @param midi_value valid MIDI value
- * @param use_sharps choose whether to use sharps for flats for accidentals
+ * @param str Characters to parse
+ * @param value Receives the parsed pitch on success
+ * @return std::from_chars_result see parsePitch(const char *, const char *, PackedPitch &)
  */
-Pitch::Pitch(unsigned short midi_value, bool use_sharps)
+std::from_chars_result parsePitch(std::string_view str, PackedPitch &value) noexcept
 {
-    std::string error_message = "Couldn't parse midi value to note: " + midi_value;
-    if (midi_value > 127 || midi_value < 10)
-    {
-        throw PitchParsingException(error_message.c_str());
-    }
+    return parsePitch(str.data(), str.data() + str.size(), value);
+}
 
-    int r = midi_value % 12;
+namespace
+{
 
-    if (r == 0)
-    {
-        key = Key(Key::Type::C);
-    }
-    else if (r == 1)
+//! Separators allowed between pitch names in parsePitches: whitespace and commas
+inline bool isPitchSeparator(char c)
+{
+    return c == ' ' || c == ',' || (c >= '\t' && c <= '\r');
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+//! Bit i is set when p[i] is a separator, for the 64 bytes at p
+inline std::uint64_t separatorMask(const char *p)
+{
+    std::uint64_t mask = 0;
+#if defined(__AVX2__)
+    for (int i = 0; i < 2; ++i)
     {
-        if (use_sharps)
-        {
-            key = Key(Key::Type::C);
-            accidental = Accidental(Accidental::Type::sharp);
-        }
-        else
-        {
-            key = Key(Key::Type::D);
-            accidental = Accidental(Accidental::Type::flat);
-        }
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32 * i));
+        __m256i control = _mm256_sub_epi8(bytes, _mm256_set1_epi8('\t'));
+        __m256i is_control = _mm256_cmpeq_epi8(_mm256_min_epu8(control, _mm256_set1_epi8('\r' - '\t')), control);
+        __m256i is_space = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+        __m256i is_comma = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(','));
+        __m256i is_separator = _mm256_or_si256(is_control, _mm256_or_si256(is_space, is_comma));
+        mask |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(is_separator))) << 32 * i;
     }
-    else if (r == 2)
+#else
+    for (int i = 0; i < 4; ++i)
     {
-        key = Key(Key::Type::D);
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * i));
+        __m128i control = _mm_sub_epi8(bytes, _mm_set1_epi8('\t'));
+        __m128i is_control = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control);
+        __m128i is_space = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+        __m128i is_comma = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(','));
+        __m128i is_separator = _mm_or_si128(is_control, _mm_or_si128(is_space, is_comma));
+        mask |= static_cast<std::uint64_t>(_mm_movemask_epi8(is_separator)) << 16 * i;
     }
-    else if (r == 3)
+#endif
+    return mask;
+}
+#endif
+
+//! Returns the first position in [it, last) whose separator-ness equals separator
+const char *scanSeparators(const char *it, const char *last, bool separator)
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    while (last - it >= 64)
     {
-        if (use_sharps)
+        std::uint64_t mask = separator ? separatorMask(it) : ~separatorMask(it);
+        if (mask)
         {
-            key = Key(Key::Type::D);
-            accidental = Accidental(Accidental::Type::sharp);
+            return it + __builtin_ctzll(mask);
         }
-        else
-        {
-            key = Key(Key::Type::E);
-            accidental = Accidental(Accidental::Type::flat);
-        }
-    }
-    else if (r == 4)
-    {
-        key = Key(Key::Type::E);
+        it += 64;
     }
-    else if (r == 5)
+#endif
+    while (it != last && isPitchSeparator(*it) != separator)
     {
-        key = Key(Key::Type::F);
+        ++it;
     }
-    else if (r == 6)
-    {
-        if (use_sharps)
+    return it;
+}
+
+//! Splits [first, last) into separated tokens and hands each parsed pitch to store
+/*!
+  With SSE2/AVX2 the separators of 64 bytes are classified at once and every
+  token starting in that block is found from the resulting bit mask; the
+  remaining tail is tokenized byte by byte. Tokens are always decoded by
+  parsePitch so both paths accept exactly what Pitch(std::string) accepts.
+*/
+template <typename Out, typename Store>
+PitchBatchResult parsePitchTokens(const char *first, const char *last, Out *out, std::size_t capacity, Store store)
+{
+    std::size_t count = 0;
+    auto take = [&](const char *begin, const char *end) {
+        if (count == capacity)
         {
-            key = Key(Key::Type::F);
-            accidental = Accidental(Accidental::Type::sharp);
+            return std::errc::value_too_large;
         }
-        else
+        PackedPitch p;
+        auto result = parsePitch(begin, end, p);
+        if (result.ec != std::errc() || result.ptr != end)
         {
-            key = Key(Key::Type::G);
-            accidental = Accidental(Accidental::Type::flat);
+            return std::errc::invalid_argument;
         }
-    }
-    else if (r == 7)
-    {
-        key = Key(Key::Type::G);
-    }
-    else if (r == 8)
-    {
-        if (use_sharps)
+        if (!store(out[count], p))
         {
-            key = Key(Key::Type::G);
-            accidental = Accidental(Accidental::Type::sharp);
+            return std::errc::result_out_of_range;
         }
-        else
+        ++count;
+        return std::errc();
+    };
+
+    const char *it = first;
+#if defined(__AVX2__) || defined(__SSE2__)
+    const char *consumed = first;
+    std::uint64_t previous_separator = 1;
+    while (last - it >= 64)
+    {
+        std::uint64_t separators = separatorMask(it);
+        std::uint64_t starts = ~separators & (separators << 1 | previous_separator);
+        previous_separator = separators >> 63;
+        while (starts)
         {
-            key = Key(Key::Type::A);
-            accidental = Accidental(Accidental::Type::flat);
+            int start = __builtin_ctzll(starts);
+            starts &= starts - 1;
+            std::uint64_t following = separators >> start;
+            const char *begin = it + start;
+            const char *end = following ? begin + __builtin_ctzll(following) : scanSeparators(it + 64, last, true);
+            auto ec = take(begin, end);
+            if (ec != std::errc())
+            {
+                return {begin, count, ec};
+            }
+            consumed = end;
         }
+        it += 64;
     }
-    else if (r == 9)
+    if (consumed > it)
     {
-        key = Key(Key::Type::A);
+        it = consumed;
     }
-    else if (r == 10)
+#endif
+
+    it = scanSeparators(it, last, false);
+    while (it != last)
     {
-        if (use_sharps)
-        {
-            key = Key(Key::Type::A);
-            accidental = Accidental(Accidental::Type::sharp);
-        }
-        else
+        const char *end = scanSeparators(it, last, true);
+        auto ec = take(it, end);
+        if (ec != std::errc())
         {
-            key = Key(Key::Type::B);
-            accidental = Accidental(Accidental::Type::flat);
+            return {it, count, ec};
         }
+        it = scanSeparators(end, last, false);
     }
-    else
-    {
-        key = Key(Key::Type::B);
-    }
-
-    octave = (midi_value - 12) / 12;
+    return {last, count, std::errc()};
 }
 
+} // namespace
+
 /**
- * @brief Returns Key object of the Pitch
+ * @brief Parses every pitch name in a buffer of whitespace or comma separated names
+ *
+ * @details Each name must be a complete Pitch string as accepted by Pitch(std::string).
+ * Token boundaries are found with SSE2 (or AVX2 when compiled with it) a block at a
+ * time. Stops at the first bad name (std::errc::invalid_argument) or when out is
+ * full (std::errc::value_too_large), with ptr at the offending name.
  *
- * @return Key
+ * @param first Start of the text
+ * @param last One past the end of the text
+ * @param out Receives the parsed pitches
+ * @param capacity Number of pitches out can hold
+ * @return PitchBatchResult
  */
-Key Pitch::getKey()
+PitchBatchResult parsePitches(const char *first, const char *last, PackedPitch *out, std::size_t capacity) noexcept
 {
-    return key;
+    return parsePitchTokens(first, last, out, capacity, [](PackedPitch &dst, PackedPitch p) {
+        dst = p;
+        return true;
+    });
 }
 
 /**
- * @brief Returns the Accidental object of the Pitch
+ * @brief Parses every pitch name in a buffer straight to MIDI values
  *
- * @return Accidental
+ * @details Same as parsePitches(const char *, const char *, PackedPitch *, std::size_t),
+ * but additionally stops with std::errc::result_out_of_range on a name above MIDI 127.
+ *
+ * @param first Start of the text
+ * @param last One past the end of the text
+ * @param midi_out Receives the MIDI values
+ * @param capacity Number of values midi_out can hold
+ * @return PitchBatchResult
  */
-Accidental Pitch::getAccidental()
+PitchBatchResult parsePitches(const char *first, const char *last, std::uint8_t *midi_out,
+                              std::size_t capacity) noexcept
 {
-    return accidental;
+    return parsePitchTokens(first, last, midi_out, capacity, [](std::uint8_t &dst, PackedPitch p) {
+        auto midi = p.getMidiValue();
+        dst = static_cast<std::uint8_t>(midi);
+        return midi <= 127;
+    });
 }
 
 /**
- * @brief Returns the octave of the Pitch
+ * @brief Writes an array of pitches into one buffer, separated by separator
+ *
+ * @details Never allocates. When the buffer runs out, ec is std::errc::value_too_large
+ * and ptr/count describe the pitches completely written so far, so the caller can
+ * flush the buffer and continue from pitches + count.
  *
- * @return unsigned short
+ * @param pitches Pitches to write
+ * @param count Number of pitches
+ * @param first Start of the output buffer
+ * @param last One past the end of the output buffer
+ * @param separator Written between consecutive pitches
+ * @return PitchFormatResult
  */
-unsigned short Pitch::getOctave()
+PitchFormatResult formatPitches(const PackedPitch *pitches, std::size_t count, char *first, char *last,
+                                char separator) noexcept
 {
-    return octave;
+    char *it = first;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        char *start = it;
+        if (i != 0)
+        {
+            if (start == last)
+            {
+                return {it, i, std::errc::value_too_large};
+            }
+            *start++ = separator;
+        }
+        auto result = pitches[i].toChars(start, last);
+        if (result.ec != std::errc())
+        {
+            return {it, i, result.ec};
+        }
+        it = result.ptr;
+    }
+    return {it, count, std::errc()};
 }
 
-/**
- * @brief Calculates and returns the midi value of a Pitch
- *
- * @return unsigned short valid midi value
- */
-unsigned short Pitch::getMidiValue()
+namespace
+{
+
+// Approximations of 2^x and log2(x) shared by the SSE2 and scalar paths, which
+// perform the same float operations in the same order and so give identical results.
+// 2^r for r in [-0.5, 0.5] is the degree 6 Taylor series of e^(r ln 2); log2(m) for m
+// in [sqrt(1/2), sqrt(2)) is 2/ln(2) atanh(s) with s = (m - 1) / (m + 1) to s^7.
+
+constexpr float exp2_c1 = 0.6931471805599453f;
+constexpr float exp2_c2 = 0.2402265069591007f;
+constexpr float exp2_c3 = 0.055504108664821576f;
+constexpr float exp2_c4 = 0.009618129107628477f;
+constexpr float exp2_c5 = 0.0013333558146428441f;
+constexpr float exp2_c6 = 0.00015403530393381606f;
+constexpr float log2_scale = 2.8853900817779268f; // 2 / ln(2)
+constexpr std::int32_t sqrt_half_bits = 0x3F3504F3;
+
+float approxExp2(float x)
 {
-    int midi_val;
-    switch (key.getType())
+    if (x != x)
     {
-    case Key::Type::A:
-        midi_val = 21;
-        break;
-    case Key::Type::B:
-        midi_val = 23;
-        break;
-    case Key::Type::C:
-        midi_val = 12;
-        break;
-    case Key::Type::D:
-        midi_val = 14;
-        break;
-    case Key::Type::E:
-        midi_val = 16;
-        break;
-    case Key::Type::F:
-        midi_val = 17;
-        break;
-    case Key::Type::G:
-        midi_val = 19;
-        break;
+        return x;
     }
-    switch (accidental.getType())
+    x = std::min(std::max(x, -126.0f), 126.0f);
+    float n = std::nearbyint(x);
+    float r = x - n;
+    float p = exp2_c6;
+    p = p * r + exp2_c5;
+    p = p * r + exp2_c4;
+    p = p * r + exp2_c3;
+    p = p * r + exp2_c2;
+    p = p * r + exp2_c1;
+    p = p * r + 1.0f;
+    std::int32_t scale_bits = (static_cast<std::int32_t>(n) + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &scale_bits, sizeof(scale));
+    return p * scale;
+}
+
+float approxLog2(float x)
+{
+    if (!(x > 0.0f))
     {
-    case Accidental::Type::sharp:
-        ++midi_val;
-        break;
-    case Accidental::Type::flat:
-        --midi_val;
-        break;
-    case Accidental::Type::double_sharp:
-        midi_val += 2;
-        break;
-    case Accidental::Type::double_flat:
-        midi_val -= 2;
-        break;
-    default:
-        break;
+        return std::numeric_limits<float>::quiet_NaN();
     }
-    midi_val += (octave * 12);
-    return midi_val;
+    std::int32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    std::int32_t exponent = (bits - sqrt_half_bits) >> 23;
+    std::int32_t mantissa_bits = bits - (exponent << 23);
+    float m;
+    std::memcpy(&m, &mantissa_bits, sizeof(m));
+    float s = (m - 1.0f) / (m + 1.0f);
+    float s2 = s * s;
+    float p = 1.0f / 7;
+    p = p * s2 + 1.0f / 5;
+    p = p * s2 + 1.0f / 3;
+    p = p * s2 + 1.0f;
+    return static_cast<float>(exponent) + p * s * log2_scale;
+}
+
+#if defined(__AVX2__) || defined(__SSE2__)
+__m128 approxExp2(__m128 input)
+{
+    __m128 x = _mm_min_ps(_mm_max_ps(input, _mm_set1_ps(-126.0f)), _mm_set1_ps(126.0f));
+    __m128i n = _mm_cvtps_epi32(x);
+    __m128 r = _mm_sub_ps(x, _mm_cvtepi32_ps(n));
+    __m128 p = _mm_set1_ps(exp2_c6);
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(exp2_c5));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(exp2_c4));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(exp2_c3));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(exp2_c2));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(exp2_c1));
+    p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.0f));
+    __m128i scale_bits = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23);
+    __m128 result = _mm_mul_ps(p, _mm_castsi128_ps(scale_bits));
+    __m128 nan = _mm_cmpunord_ps(input, input);
+    return _mm_or_ps(_mm_andnot_ps(nan, result), _mm_and_ps(nan, input));
+}
+
+__m128 approxLog2(__m128 x)
+{
+    __m128i bits = _mm_castps_si128(x);
+    __m128i exponent = _mm_srai_epi32(_mm_sub_epi32(bits, _mm_set1_epi32(sqrt_half_bits)), 23);
+    __m128 m = _mm_castsi128_ps(_mm_sub_epi32(bits, _mm_slli_epi32(exponent, 23)));
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 s = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+    __m128 s2 = _mm_mul_ps(s, s);
+    __m128 p = _mm_set1_ps(1.0f / 7);
+    p = _mm_add_ps(_mm_mul_ps(p, s2), _mm_set1_ps(1.0f / 5));
+    p = _mm_add_ps(_mm_mul_ps(p, s2), _mm_set1_ps(1.0f / 3));
+    p = _mm_add_ps(_mm_mul_ps(p, s2), one);
+    __m128 result = _mm_add_ps(_mm_cvtepi32_ps(exponent), _mm_mul_ps(_mm_mul_ps(p, s), _mm_set1_ps(log2_scale)));
+    __m128 positive = _mm_cmpgt_ps(x, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(positive, result),
+                     _mm_andnot_ps(positive, _mm_set1_ps(std::numeric_limits<float>::quiet_NaN())));
 }
+#endif
+
+} // namespace
 
 /**
- * @brief Calculates and returns the frequency of a Pitch in hz
+ * @brief Converts integer midi values to frequencies in hz, exactly
+ *
+ * @details Every value is a single load from the same table Pitch::getFrequency uses
  *
- * @return double
+ * @param midi_values Midi values to convert
+ * @param count Number of values
+ * @param frequencies Receives count frequencies
  */
-double Pitch::getFrequency()
+void midiToFrequencies(const std::uint8_t *midi_values, std::size_t count, double *frequencies) noexcept
 {
-    return std::pow(2, (getMidiValue() - 69) / 12.0) * 440;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        frequencies[i] = midi_values[i] < 128 ? detail::midi_frequencies.frequencies[midi_values[i]]
+                                              : detail::frequencyFromMidi(midi_values[i]);
+    }
 }
 
 /**
- * @brief Returns the Pitch string, i.e "Bb3"
+ * @brief Converts fractional midi values, i.e. with pitch bend, to frequencies in hz
  *
- * @return std::string Key Accidental Octave i.e "C#4"
+ * @details Uses an SSE2 approximation of 2^x, 4 values at a time. Each result is
+ * within 0.002 cents of the exact frequency, as long as it is a normal float. NaN
+ * inputs give NaN.
+ *
+ * @param midi_values Midi values to convert
+ * @param count Number of values
+ * @param frequencies Receives count frequencies
  */
-std::string Pitch::toString()
+void midiToFrequencies(const float *midi_values, std::size_t count, float *frequencies) noexcept
 {
-    return key.toString() + accidental.toString() + std::to_string(octave);
+    const float a4 = static_cast<float>(a4_frequency);
+    std::size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(midi_values + i), _mm_set1_ps(69.0f)), _mm_set1_ps(1.0f / 12));
+        _mm_storeu_ps(frequencies + i, _mm_mul_ps(approxExp2(x), _mm_set1_ps(a4)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        frequencies[i] = approxExp2((midi_values[i] - 69.0f) * (1.0f / 12)) * a4;
+    }
 }
 
 /**
- * @brief Construct a new Interval object
+ * @brief Converts frequencies in hz to fractional midi values
  *
- * @details Throws InvalidIntervalException on bad construction calls
+ * @details Uses an SSE2 approximation of log2(x), 4 values at a time. Each result is
+ * within 0.002 cents of the exact midi value for normal positive frequencies; other
+ * inputs give NaN.
  *
- * @param q Quality of the Interval
- * @param d Degree of the Interval
+ * @param frequencies Frequencies to convert
+ * @param count Number of values
+ * @param midi_values Receives count midi values
  */
-Interval::Interval(Quality q, unsigned short d)
+void frequenciesToMidi(const float *frequencies, std::size_t count, float *midi_values) noexcept
+{
+    const float inverse_a4 = static_cast<float>(1 / a4_frequency);
+    std::size_t i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = approxLog2(_mm_mul_ps(_mm_loadu_ps(frequencies + i), _mm_set1_ps(inverse_a4)));
+        _mm_storeu_ps(midi_values + i, _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(12.0f)), _mm_set1_ps(69.0f)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        midi_values[i] = approxLog2(frequencies[i] * inverse_a4) * 12.0f + 69.0f;
+    }
+}
+
+namespace
+{
+
+//! Lowest frequency rounding to each midi value, and the highest one for 127 at index 128
+struct MidiBoundaryTable
 {
-    std::string error_msg = "Invalid interval error. Need valid quality and degree";
-    quality = q;
-    degree = d;
+    double lower[129];
+};
 
-    if (degree < 1)
+constexpr MidiBoundaryTable makeMidiBoundaryTable()
+{
+    constexpr double half_semitone_down = 0.9715319411536059; // 2^(-1/24)
+    MidiBoundaryTable table{};
+    for (int midi_value = 0; midi_value < 129; ++midi_value)
     {
-        throw InvalidIntervalException(error_msg.c_str());
+        table.lower[midi_value] = detail::frequencyFromMidi(midi_value) * half_semitone_down;
     }
+    return table;
+}
 
-    if (quality == Quality::perfect)
+constexpr MidiBoundaryTable midi_boundaries = makeMidiBoundaryTable();
+
+//! Rounds an approximate fractional midi value of frequency to the exact nearest midi value
+PitchEstimate estimatePitch(double frequency, float midi_value, bool use_sharps)
+{
+    if (std::isnan(midi_value))
     {
-        // octave/unison || 4th || 5ths
-        if (!(degree % 7 == 1 || degree % 7 == 4 || degree % 7 == 5))
-        {
-            throw InvalidIntervalException(error_msg.c_str());
-        }
+        return {PackedPitch(), 0, midi_value};
     }
-    else if (quality == Quality::major || quality == Quality::minor)
+    // The guess is within a hair of the true value, so rounding ties need no care here
+    int nearest = static_cast<int>(std::min(std::max(midi_value, 0.0f), 127.0f) + 0.5f);
+    if (nearest > 0 && frequency < midi_boundaries.lower[nearest])
     {
-        if (!(degree % 7 == 2 || degree % 7 == 3 || degree % 7 == 6 || degree % 7 == 0))
-        {
-            throw InvalidIntervalException(error_msg.c_str());
-        }
+        --nearest;
     }
-    else if (quality == Quality::dimished)
+    else if (nearest < 127 && frequency >= midi_boundaries.lower[nearest + 1])
     {
-        if (degree < 2)
-        {
-            throw InvalidIntervalException(error_msg.c_str());
-        }
+        ++nearest;
     }
+    auto midi = static_cast<std::uint8_t>(nearest);
+    return {PackedPitch::fromMidi(midi, use_sharps), midi, 100 * (midi_value - nearest)};
 }
 
+} // namespace
+
 /**
- * @brief Construct a new Interval object from a semitone value
+ * @brief Finds the nearest Pitch to a frequency in hz
+ *
+ * @details The fast log2 behind frequenciesToMidi gives a guess that is corrected
+ * against a precomputed table of the frequencies halfway between midi values.
+ * Frequencies outside the MIDI range give 0 or 127 with cents beyond +-50;
+ * non-positive frequencies give NaN cents.
  *
- * @param s Semitones away from a root
+ * @param frequency Frequency in hz
+ * @param use_sharps choose whether to use sharps for flats for accidentals
+ * @return PitchEstimate
  */
-Interval::Interval(unsigned short s)
+PitchEstimate nearestPitch(double frequency, bool use_sharps) noexcept
 {
-    auto r = s % 12;
-    auto q = s / 12;
-
-    switch (r)
-    {
-    case 0:
-        quality = Quality::perfect;
-        degree = 1 + 7 * q;
-        break;
-    case 1:
-        quality = Quality::minor;
-        degree = 2 + 7 * q;
-        break;
-    case 2:
-        quality = Quality::major;
-        degree = 2 + 7 * q;
-        break;
-    case 3:
-        quality = Quality::minor;
-        degree = 3 + 7 * q;
-        break;
-    case 4:
-        quality = Quality::major;
-        degree = 3 + 7 * q;
-        break;
-    case 5:
-        quality = Quality::perfect;
-        degree = 4 + 7 * q;
-        break;
-    case 6:
-        quality = Quality::augmented;
-        degree = 4 + 7 * q;
-        break;
-    case 7:
-        quality = Quality::perfect;
-        degree = 5 + 7 * q;
-        break;
-    case 8:
-        quality = Quality::minor;
-        degree = 6 + 7 * q;
-        break;
-    case 9:
-        quality = Quality::major;
-        degree = 6 + 7 * q;
-        break;
-    case 10:
-        quality = Quality::minor;
-        degree = 7 + 7 * q;
-        break;
-    case 11:
-        quality = Quality::major;
-        degree = 7 + 7 * q;
-        break;
-    }
+    float midi_value;
+    float f = static_cast<float>(frequency);
+    frequenciesToMidi(&f, 1, &midi_value);
+    return estimatePitch(frequency, midi_value, use_sharps);
 }
 
 /**
- * @brief Returns Quality object of an Interval
+ * @brief Finds the nearest Pitch to each of an array of frequencies in hz
  *
- * @return Interval::Quality
+ * @details Same as nearestPitch, with the log2 done 4 frequencies at a time;
+ * meant for pitch tracker output at audio frame rates.
+ *
+ * @param frequencies Frequencies to look up
+ * @param count Number of frequencies
+ * @param estimates Receives count estimates
+ * @param use_sharps choose whether to use sharps for flats for accidentals
  */
-Interval::Quality Interval::getQuality()
+void nearestPitches(const float *frequencies, std::size_t count, PitchEstimate *estimates, bool use_sharps) noexcept
 {
-    return quality;
+    float midi_values[256];
+    for (std::size_t done = 0; done < count; done += 256)
+    {
+        std::size_t chunk = std::min<std::size_t>(count - done, 256);
+        frequenciesToMidi(frequencies + done, chunk, midi_values);
+        for (std::size_t i = 0; i < chunk; ++i)
+        {
+            estimates[done + i] = estimatePitch(frequencies[done + i], midi_values[i], use_sharps);
+        }
+    }
 }
 
 /**
- * @brief Returns degree of an inerval
+ * @brief Returns Pitch that corresponds with this Interval from a given root
  *
- * @return unsigned short
+ * @param root Pitch that acts as a root for this Interval
+ * @return Pitch New Pitch from the root
  */
-unsigned short Interval::getDegree()
+Pitch Interval::getPitchFromRoot(Pitch root) const
 {
-    return degree;
+    return Pitch(root.getMidiValue() + getSemitones());
 }
 
 /**
- * @brief Returns how many semitones away this Interval is from the root
+ * @brief Returns Pitch that corresponds with this Interval from a given root, spelled correctly
  *
- * @return unsigned short
+ * @details Unlike getPitchFromRoot the letter moves by the degree, so Bb3 up a minor
+ * 3rd is Db4 rather than C#4. Throws PitchParsingException if the result would
+ * need more than a double accidental
+ *
+ * @param root Pitch that acts as a root for this Interval
+ * @return Pitch New Pitch from the root
  */
-unsigned short Interval::getSemitones()
+Pitch Interval::getSpelledPitchFromRoot(Pitch root) const
 {
-    if (quality == Quality::perfect)
+    PackedPitch p(root);
+    if (!transpose(p, *this))
     {
-        if (degree % 7 == 1)
-        {
-            return 12 * (degree / 7);
-        }
-        else if (degree % 7 == 4)
+        std::string error_message = "Can't spell " + toString() + " above " + root.toString();
+        throw PitchParsingException(error_message.c_str());
+    }
+    return Pitch(p);
+}
+
+namespace
+{
+
+//! Transposition by one interval, precomputed as letter steps and semitones
+struct Transposition
+{
+    int steps;
+    int semitones;
+
+    Transposition(Interval interval, bool up)
+    {
+        steps = interval.getDegree() - 1;
+        semitones = interval.getSemitones();
+        if (!up)
         {
-            return 5 + 12 * (degree / 7);
-        }
-        else if (degree % 7 == 5)
-        {
-            return 7 + 12 * (degree / 7);
+            steps = -steps;
+            semitones = -semitones;
         }
     }
-    else if (quality == Quality::major)
+
+    //! Moves the letter by steps and picks the accidental that makes up the semitones
+    bool apply(PackedPitch &pitch) const
     {
-        if (degree % 7 == 2)
-        {
-            return 2 + 12 * (degree / 7);
-        }
-        else if (degree % 7 == 3)
-        {
-            return 4 + 12 * (degree / 7);
-        }
-        else if (degree % 7 == 6)
+        static const int letters_from_c[] = {5, 6, 0, 1, 2, 3, 4};  // indexed by Key::Type
+        static const int c_semitones[] = {0, 2, 4, 5, 7, 9, 11};    // indexed by letter from C
+        static const Key::Type keys[] = {Key::Type::C, Key::Type::D, Key::Type::E, Key::Type::F,
+                                         Key::Type::G, Key::Type::A, Key::Type::B};
+        static const Accidental::Type accidentals[] = {Accidental::Type::double_flat, Accidental::Type::flat,
+                                                       Accidental::Type::natural, Accidental::Type::sharp,
+                                                       Accidental::Type::double_sharp};
+
+        int letter = 7 * (pitch.getOctave() + 1) + letters_from_c[static_cast<int>(pitch.getKeyType())] + steps;
+        if (letter < 0)
         {
-            return 9 + 12 * (degree / 7);
+            return false;
         }
-        else if (degree % 7 == 0)
+        int octave = letter / 7 - 1;
+        int midi_value = 12 * (pitch.getOctave() + 1) + detail::key_semitones[static_cast<int>(pitch.getKeyType())] +
+                         detail::accidental_semitones[static_cast<int>(pitch.getAccidentalType())] + semitones;
+        int alteration = midi_value - 12 * (octave + 1) - c_semitones[letter % 7];
+        if (alteration < -2 || alteration > 2 || octave > 14)
         {
-            return 11 + 12 * ((degree / 7) - 1);
+            return false;
         }
+        pitch = PackedPitch(keys[letter % 7], accidentals[alteration + 2], static_cast<short>(octave));
+        return true;
     }
-    else if (quality == Quality::minor)
+};
+
+} // namespace
+
+/**
+ * @brief Transposes a pitch by an interval, keeping correct spelling
+ *
+ * @details Constant time: the letter moves by the interval's degree and the
+ * accidental makes up its semitones, so Bb3 up a minor 3rd is Db4
+ *
+ * @param pitch Pitch to transpose in place
+ * @param interval Interval to transpose by
+ * @param up Transpose up when true, down otherwise
+ * @return bool false, leaving pitch untouched, if the result would need more than a
+ * double accidental or leave octaves -1 to 14
+ */
+bool transpose(PackedPitch &pitch, Interval interval, bool up) noexcept
+{
+    return Transposition(interval, up).apply(pitch);
+}
+
+/**
+ * @brief Transposes an array of pitches in place by an interval, keeping correct spelling
+ *
+ * @param pitches Pitches to transpose in place
+ * @param count Number of pitches
+ * @param interval Interval to transpose by
+ * @param up Transpose up when true, down otherwise
+ * @return std::size_t Number of pitches transposed; less than count if pitches[result]
+ * could not be spelled, see transpose(PackedPitch &, Interval, bool)
+ */
+std::size_t transpose(PackedPitch *pitches, std::size_t count, Interval interval, bool up) noexcept
+{
+    Transposition transposition(interval, up);
+    for (std::size_t i = 0; i < count; ++i)
     {
-        if (degree % 7 == 2)
-        {
-            return 1 + 12 * (degree / 7);
-        }
-        else if (degree % 7 == 3)
+        if (!transposition.apply(pitches[i]))
         {
-            return 3 + 12 * (degree / 7);
-        }
-        else if (degree % 7 == 6)
-        {
-            return 8 + 12 * (degree / 7);
-        }
-        else if (degree % 7 == 0)
-        {
-            return 10 + 12 * ((degree / 7) - 1);
+            return i;
         }
     }
-    else if (quality == Quality::augmented)
+    return count;
+}
+
+namespace
+{
+
+//! Letter position counted in steps from C-1, without any table lookups
+inline int letterPosition(std::uint16_t bits)
+{
+    int key = bits >> 3 & 0x7;
+    return 7 * (bits >> 6 & 0xF) + (key >= 2 ? key - 2 : key + 5);
+}
+
+//! Same as PackedPitch::getMidiValue but arithmetic only, so loops over it vectorize
+inline int midiPosition(std::uint16_t bits)
+{
+    int key = bits >> 3 & 0x7;
+    int letter = key >= 2 ? key - 2 : key + 5;
+    int accidental = bits & 0x7;
+    int alteration = (accidental + 1) >> 1;
+    return 12 * (bits >> 6 & 0xF) + 2 * letter - (letter >= 3) + (accidental & 1 ? -alteration : alteration);
+}
+
+//! Writes position(pitches[i]) - position(pitches[i - 1]). int16_t may alias the bits of a
+//! PackedPitch, so without __restrict the loop needs a runtime alias check before it vectorizes.
+//! Blocks of 8 have a fixed trip count, which -O2 will vectorize too
+template <typename F>
+inline void differences(const PackedPitch *__restrict pitches, std::size_t count, std::int16_t *__restrict out,
+                        F position)
+{
+    std::size_t i = 1;
+    for (; i + 8 <= count; i += 8)
     {
-        if (degree % 7 == 4)
+        for (std::size_t j = 0; j < 8; ++j)
         {
-            return 6 + 12 * (degree / 7);
+            out[i + j - 1] = static_cast<std::int16_t>(position(pitches[i + j].getBits()) -
+                                                       position(pitches[i + j - 1].getBits()));
         }
     }
-    return 0;
+    for (; i < count; ++i)
+    {
+        out[i - 1] = static_cast<std::int16_t>(position(pitches[i].getBits()) - position(pitches[i - 1].getBits()));
+    }
 }
 
+} // namespace
+
 /**
- * @brief Returns Pitch that corresponds with this Interval from a given root
+ * @brief Returns the Interval between two pitches, whichever order they come in
  *
- * @param root Pitch that acts as a root for this Interval
- * @return Pitch New Pitch from the root
+ * @details Spelled intervals count the letters between the pitches, so C4 to Eb4 is a
+ * minor 3rd and C4 to D#4 an augmented 2nd. Otherwise the usual spelling for the
+ * semitones is used, see Interval(unsigned short). Throws InvalidIntervalException
+ * if no quality spans the spelled interval, i.e. B#3 to Cb4
+ *
+ * @param a One pitch
+ * @param b The other pitch
+ * @param spelled Whether to use the pitches' spelling
+ * @return Interval
  */
-Pitch Interval::getPitchFromRoot(Pitch root)
+Interval intervalBetween(PackedPitch a, PackedPitch b, bool spelled)
 {
-    return Pitch(root.getMidiValue() + getSemitones());
+    int steps = letterPosition(b.getBits()) - letterPosition(a.getBits());
+    int semitones = midiPosition(b.getBits()) - midiPosition(a.getBits());
+    if (!spelled)
+    {
+        return Interval(static_cast<unsigned short>(std::abs(semitones)));
+    }
+    if (steps < 0 || (steps == 0 && semitones < 0))
+    {
+        steps = -steps;
+        semitones = -semitones;
+    }
+    if (semitones < 0)
+    {
+        throw InvalidIntervalException("Invalid interval error. No quality spans those pitches");
+    }
+    return Interval(static_cast<unsigned short>(semitones), static_cast<unsigned short>(steps + 1));
+}
+
+/**
+ * @brief Returns the Interval between two pitches, see intervalBetween(PackedPitch, PackedPitch, bool)
+ *
+ * @param a One pitch
+ * @param b The other pitch
+ * @param spelled Whether to use the pitches' spelling
+ * @return Interval
+ */
+Interval intervalBetween(const Pitch &a, const Pitch &b, bool spelled)
+{
+    return intervalBetween(PackedPitch(a), PackedPitch(b), spelled);
+}
+
+/**
+ * @brief Fills in the melodic intervals between consecutive pitches of a melody
+ *
+ * @details Writes count - 1 signed values to each output, positive when the melody
+ * goes up. steps is the letter distance, 0 for a unison and 2 for a 3rd, and is
+ * skipped when null. No Interval objects are made, and the loop is branch and table
+ * free so the compiler can vectorize it
+ *
+ * @param pitches Melody to read
+ * @param count Number of pitches
+ * @param semitones Output of count - 1 semitone differences
+ * @param steps Output of count - 1 letter step differences, or nullptr
+ */
+void melodicIntervals(const PackedPitch *pitches, std::size_t count, std::int16_t *semitones,
+                      std::int16_t *steps) noexcept
+{
+    differences(pitches, count, semitones, midiPosition);
+    if (steps != nullptr)
+    {
+        differences(pitches, count, steps, letterPosition);
+    }
 }
 
 /**
@@ -665,50 +1045,681 @@ Pitch Interval::getPitchFromRoot(Pitch root)
  *
  * @return std::string
  */
-std::string Interval::toString()
+std::string Interval::toString() const
 {
-    std::string result = "";
+    char buffer[8];
+    auto result = toChars(buffer, buffer + sizeof(buffer));
+    return std::string(buffer, result.ptr);
+}
+
+/**
+ * @brief Writes the Interval markup string, i.e "m3", into [first, last) without allocating
+ *
+ * @param first Start of the output buffer
+ * @param last One past the end of the output buffer
+ * @return std::to_chars_result ec is std::errc::value_too_large if the buffer is too small
+ */
+std::to_chars_result Interval::toChars(char *first, char *last) const
+{
+    if (last - first < 1)
+    {
+        return {last, std::errc::value_too_large};
+    }
     switch (quality)
     {
     case Quality::perfect:
-        result += "P";
+        *first = 'P';
         break;
     case Quality::minor:
-        result += "m";
+        *first = 'm';
         break;
     case Quality::major:
-        result += "M";
+        *first = 'M';
         break;
     case Quality::augmented:
-        result += "A";
+        *first = 'A';
         break;
     case Quality::dimished:
-        result += "d";
+        *first = 'd';
         break;
+    case Quality::doubly_augmented:
+    case Quality::doubly_diminished:
+        if (last - first < 2)
+        {
+            return {last, std::errc::value_too_large};
+        }
+        first[0] = first[1] = quality == Quality::doubly_augmented ? 'A' : 'd';
+        return std::to_chars(first + 2, last, degree);
     }
-    result += std::to_string(degree);
-    return result;
+    return std::to_chars(first + 1, last, degree);
 }
 
+namespace
+{
+
+//! Fills pitches, which may use any allocator, with the pitches of intervals over root.
+//! Throws PitchParsingException if a pitch would leave the MIDI range
+template <typename Vector> void expandPitches(IntervalSpan intervals, Pitch root, Vector &pitches)
+{
+    unsigned root_midi = root.getMidiValue();
+    pitches.resize(intervals.size());
+    for (std::size_t i = 0; i < intervals.size(); ++i)
+    {
+        unsigned midi_value = root_midi + intervals[i].getSemitones();
+        if (midi_value > 127)
+        {
+            std::string error_message = "Couldn't parse midi value to note: " + std::to_string(midi_value);
+            throw PitchParsingException(error_message.c_str());
+        }
+        pitches[i] = Pitch(PackedPitch::fromMidi(static_cast<std::uint8_t>(midi_value)));
+    }
+}
+
+} // namespace
+
 /**
- * @brief Namespace of convenient simple intervals to use
+ * @brief Construct a new Scale object
+ *
+ * @details Intervals are stored inline, throws InvalidIntervalException if there are
+ * more than IntervalList::capacity of them
  *
+ * @param i Intervals of the scale from its root
  */
-namespace Intervals
+Scale::Scale(std::initializer_list<Interval> i) : intervals(IntervalSpan(i.begin(), i.size()))
 {
-Interval P1(Interval::Quality::perfect, 1);
-Interval m2(Interval::Quality::minor, 2);
-Interval M2(Interval::Quality::major, 2);
-Interval m3(Interval::Quality::minor, 3);
-Interval M3(Interval::Quality::major, 3);
-Interval P4(Interval::Quality::perfect, 4);
-Interval A4(Interval::Quality::augmented, 4);
-Interval P5(Interval::Quality::perfect, 5);
-Interval m6(Interval::Quality::minor, 6);
-Interval M6(Interval::Quality::major, 6);
-Interval m7(Interval::Quality::minor, 7);
-Interval M7(Interval::Quality::major, 7);
-Interval P8(Interval::Quality::perfect, 8);
-} // namespace Intervals
+}
+
+/**
+ * @brief Construct a new Scale object, see Scale(std::initializer_list<Interval>)
+ *
+ * @param i Intervals of the scale from its root
+ */
+Scale::Scale(const std::vector<Interval> &i) : intervals(IntervalSpan(i))
+{
+}
+
+/**
+ * @brief Construct a new Scale object, see Scale(std::initializer_list<Interval>)
+ *
+ * @param i Intervals of the scale from its root
+ */
+Scale::Scale(IntervalSpan i) : intervals(i)
+{
+}
+
+/**
+ * @brief Returns a copy of the Intervals making up the Scale
+ *
+ * @details getIntervalSpan gives the same without allocating
+ *
+ * @return std::vector<Interval>
+ */
+std::vector<Interval> Scale::getIntervals() const
+{
+    IntervalSpan span = intervals.span();
+    return std::vector<Interval>(span.begin(), span.end());
+}
+
+/**
+ * @brief Returns a copy of the Intervals making up the Scale, allocated from resource
+ *
+ * @param resource Memory resource backing the result, i.e. a per-request arena
+ * @return std::pmr::vector<Interval>
+ */
+std::pmr::vector<Interval> Scale::getIntervals(std::pmr::memory_resource *resource) const
+{
+    IntervalSpan span = intervals.span();
+    return std::pmr::vector<Interval>(span.begin(), span.end(), resource);
+}
+
+/**
+ * @brief Returns the Pitches of the Scale starting from a root
+ *
+ * @details Same pitches as Interval::getPitchFromRoot gives for each interval, read
+ * straight from the midi tables. Throws PitchParsingException if a pitch would leave
+ * the MIDI range
+ *
+ * @param root Pitch the Scale starts from
+ * @return std::vector<Pitch> one Pitch per Interval
+ */
+std::vector<Pitch> Scale::getPitchesFromRoot(Pitch root) const
+{
+    std::vector<Pitch> pitches;
+    expandPitches(intervals.span(), root, pitches);
+    return pitches;
+}
+
+/**
+ * @brief Returns the Pitches of the Scale starting from a root, allocated from resource
+ *
+ * @details Same as getPitchesFromRoot(Pitch) but never touches the global heap, so a
+ * monotonic arena can hold every temporary result
+ *
+ * @param root Pitch the Scale starts from
+ * @param resource Memory resource backing the result
+ * @return std::pmr::vector<Pitch> one Pitch per Interval
+ */
+std::pmr::vector<Pitch> Scale::getPitchesFromRoot(Pitch root, std::pmr::memory_resource *resource) const
+{
+    std::pmr::vector<Pitch> pitches(resource);
+    expandPitches(intervals.span(), root, pitches);
+    return pitches;
+}
+
+/**
+ * @brief Construct a new Chord object
+ *
+ * @details Intervals are stored inline, throws InvalidIntervalException if there are
+ * more than IntervalList::capacity of them
+ *
+ * @param i Intervals of the chord from its root
+ */
+Chord::Chord(std::initializer_list<Interval> i) : intervals(IntervalSpan(i.begin(), i.size()))
+{
+}
+
+/**
+ * @brief Construct a new Chord object, see Chord(std::initializer_list<Interval>)
+ *
+ * @param i Intervals of the chord from its root
+ */
+Chord::Chord(const std::vector<Interval> &i) : intervals(IntervalSpan(i))
+{
+}
+
+/**
+ * @brief Construct a new Chord object, see Chord(std::initializer_list<Interval>)
+ *
+ * @param i Intervals of the chord from its root
+ */
+Chord::Chord(IntervalSpan i) : intervals(i)
+{
+}
+
+/**
+ * @brief Returns a copy of the Intervals making up the Chord
+ *
+ * @details getIntervalSpan gives the same without allocating
+ *
+ * @return std::vector<Interval>
+ */
+std::vector<Interval> Chord::getIntervals() const
+{
+    IntervalSpan span = intervals.span();
+    return std::vector<Interval>(span.begin(), span.end());
+}
+
+/**
+ * @brief Returns a copy of the Intervals making up the Chord, allocated from resource
+ *
+ * @param resource Memory resource backing the result, i.e. a per-request arena
+ * @return std::pmr::vector<Interval>
+ */
+std::pmr::vector<Interval> Chord::getIntervals(std::pmr::memory_resource *resource) const
+{
+    IntervalSpan span = intervals.span();
+    return std::pmr::vector<Interval>(span.begin(), span.end(), resource);
+}
+
+/**
+ * @brief Returns the Pitches of the Chord built on a root
+ *
+ * @details Same pitches as Interval::getPitchFromRoot gives for each interval, read
+ * straight from the midi tables. Throws PitchParsingException if a pitch would leave
+ * the MIDI range
+ *
+ * @param root Pitch the Chord is built on
+ * @return std::vector<Pitch> one Pitch per Interval
+ */
+std::vector<Pitch> Chord::getPitchesFromRoot(Pitch root) const
+{
+    std::vector<Pitch> pitches;
+    expandPitches(intervals.span(), root, pitches);
+    return pitches;
+}
+
+/**
+ * @brief Returns the Pitches of the Chord built on a root, allocated from resource
+ *
+ * @details Same as getPitchesFromRoot(Pitch) but never touches the global heap, so a
+ * monotonic arena can hold every temporary result
+ *
+ * @param root Pitch the Chord is built on
+ * @param resource Memory resource backing the result
+ * @return std::pmr::vector<Pitch> one Pitch per Interval
+ */
+std::pmr::vector<Pitch> Chord::getPitchesFromRoot(Pitch root, std::pmr::memory_resource *resource) const
+{
+    std::pmr::vector<Pitch> pitches(resource);
+    expandPitches(intervals.span(), root, pitches);
+    return pitches;
+}
+
+/**
+ * @brief Construct the set of pitch classes of a Scale, relative to its root
+ *
+ * @param s Scale whose intervals are reduced to within an octave
+ */
+PitchClassSet::PitchClassSet(const Scale &s) : mask(0)
+{
+    for (Interval interval : s.getIntervalSpan())
+    {
+        mask |= 1u << interval.getSemitones() % 12;
+    }
+}
+
+/**
+ * @brief Construct the set of pitch classes of a Chord, relative to its root
+ *
+ * @param c Chord whose intervals are reduced to within an octave
+ */
+PitchClassSet::PitchClassSet(const Chord &c) : mask(0)
+{
+    for (Interval interval : c.getIntervalSpan())
+    {
+        mask |= 1u << interval.getSemitones() % 12;
+    }
+}
+
+namespace
+{
+
+//! One simple Interval per pitch class of a set, in ascending order
+IntervalList intervalsOf(PitchClassSet set)
+{
+    Interval intervals[12];
+    std::size_t count = 0;
+    for (unsigned short semitones = 0; semitones < 12; ++semitones)
+    {
+        if (set.contains(semitones))
+        {
+            intervals[count++] = Interval(semitones);
+        }
+    }
+    return IntervalList(IntervalSpan(intervals, count));
+}
+
+} // namespace
+
+/**
+ * @brief Builds a Scale with one simple Interval per pitch class, in ascending order
+ *
+ * @return Scale
+ */
+Scale PitchClassSet::toScale() const
+{
+    return Scale(intervalsOf(*this).span());
+}
+
+/**
+ * @brief Builds a Chord with one simple Interval per pitch class, in ascending order
+ *
+ * @return Chord
+ */
+Chord PitchClassSet::toChord() const
+{
+    return Chord(intervalsOf(*this).span());
+}
+
+namespace
+{
+
+//! A chord recognizeChord knows about, as pitch classes above its root
+struct ChordTemplate
+{
+    const char *name;
+    std::uint16_t mask;
+};
+
+//! Known chords, most preferred first when a set of pitch classes fits several
+constexpr ChordTemplate chord_templates[] = {
+    {"", 0x091},     {"m", 0x089},     {"dim", 0x049},   {"aug", 0x111},  {"sus4", 0x0A1}, {"sus2", 0x085},
+    {"7", 0x491},    {"maj7", 0x891},  {"m7", 0x489},    {"m7b5", 0x449}, {"dim7", 0x249}, {"mMaj7", 0x889},
+    {"6", 0x291},    {"m6", 0x289},    {"aug7", 0x511},  {"7sus4", 0x4A1}, {"9", 0x495},   {"maj9", 0x895},
+    {"m9", 0x48D},   {"add9", 0x095},  {"5", 0x081},
+};
+
+constexpr int chord_template_count = sizeof(chord_templates) / sizeof(chord_templates[0]);
+constexpr std::uint8_t no_chord = 0xFF;
+
+//! Best two chords fitting one set of pitch classes, each with every root it fits on
+struct ChordCandidates
+{
+    std::uint8_t types[2];
+    std::uint16_t roots[2];
+};
+
+//! Candidates for every possible set of pitch classes, indexed by PitchClassSet mask
+struct ChordTable
+{
+    ChordCandidates sets[4096];
+};
+
+//! Whether template a explains more pitch classes than b, or as many but is preferred
+constexpr bool betterChordTemplate(int a, int b)
+{
+    if (b == no_chord)
+    {
+        return true;
+    }
+    unsigned a_size = PitchClassSet(chord_templates[a].mask).size();
+    unsigned b_size = PitchClassSet(chord_templates[b].mask).size();
+    return a_size > b_size || (a_size == b_size && a < b);
+}
+
+constexpr void addChordCandidate(ChordCandidates &candidates, int type, unsigned root)
+{
+    auto bit = static_cast<std::uint16_t>(1u << root);
+    if (candidates.types[0] == type)
+    {
+        candidates.roots[0] |= bit;
+    }
+    else if (candidates.types[1] == type)
+    {
+        candidates.roots[1] |= bit;
+    }
+    else if (betterChordTemplate(type, candidates.types[0]))
+    {
+        candidates.types[1] = candidates.types[0];
+        candidates.roots[1] = candidates.roots[0];
+        candidates.types[0] = static_cast<std::uint8_t>(type);
+        candidates.roots[0] = bit;
+    }
+    else if (betterChordTemplate(type, candidates.types[1]))
+    {
+        candidates.types[1] = static_cast<std::uint8_t>(type);
+        candidates.roots[1] = bit;
+    }
+}
+
+//! Every template on every root is offered to each superset of its pitch classes,
+//! so sets with extra tones still map to the largest chord they contain
+constexpr ChordTable makeChordTable()
+{
+    ChordTable table{};
+    for (ChordCandidates &candidates : table.sets)
+    {
+        candidates.types[0] = candidates.types[1] = no_chord;
+    }
+    for (int type = 0; type < chord_template_count; ++type)
+    {
+        for (unsigned root = 0; root < 12; ++root)
+        {
+            unsigned chord = PitchClassSet(chord_templates[type].mask).transpose(static_cast<int>(root)).getMask();
+            for (unsigned set = chord; set < 4096; set = (set + 1) | chord)
+            {
+                addChordCandidate(table.sets[set], type, root);
+            }
+        }
+    }
+    return table;
+}
+
+constexpr ChordTable chord_table = makeChordTable();
+
+} // namespace
+
+/**
+ * @brief Builds the recognized Chord, one simple Interval per chord tone
+ *
+ * @return Chord
+ */
+Chord ChordMatch::getChord() const
+{
+    return chord_tones.toChord();
+}
+
+/**
+ * @brief Recognizes the chord formed by a set of pitch classes in O(1)
+ *
+ * @details Looks the set up in a constexpr table covering all 4096 sets. Sets that
+ * match no chord exactly give the largest known chord they contain, with exact
+ * false. Where several chords or roots fit (i.e. C6 and Am7), the one with its
+ * root in the bass wins.
+ *
+ * @param pitch_classes Sounding pitch classes, 0 being C
+ * @param bass_pitch_class Pitch class of the lowest sounding pitch
+ * @return ChordMatch found is false if no known chord fits
+ */
+ChordMatch recognizeChord(PitchClassSet pitch_classes, unsigned bass_pitch_class) noexcept
+{
+    ChordMatch match{};
+    const ChordCandidates &candidates = chord_table.sets[pitch_classes.getMask()];
+    if (candidates.types[0] == no_chord)
+    {
+        return match;
+    }
+
+    unsigned bass = bass_pitch_class % 12;
+    int pick = 0;
+    if (!(candidates.roots[0] >> bass & 1) && candidates.types[1] != no_chord && candidates.roots[1] >> bass & 1)
+    {
+        pick = 1;
+    }
+    // First possible root at or above the bass
+    unsigned above_bass = PitchClassSet(candidates.roots[pick]).transpose(-static_cast<int>(bass)).getMask();
+    unsigned root = (bass + __builtin_ctz(above_bass)) % 12;
+    const ChordTemplate &chord = chord_templates[candidates.types[pick]];
+    unsigned bass_interval = (bass + 12 - root) % 12;
+
+    match.found = true;
+    match.exact = PitchClassSet(chord.mask).size() == pitch_classes.size();
+    match.root = static_cast<std::uint8_t>(root);
+    match.inversion = static_cast<std::uint8_t>(
+        chord.mask >> bass_interval & 1
+            ? PitchClassSet(static_cast<std::uint16_t>(chord.mask & ((1u << bass_interval) - 1))).size()
+            : 0);
+    match.name = chord.name;
+    match.chord_tones = PitchClassSet(chord.mask);
+    return match;
+}
+
+namespace
+{
+//! Midi values below C-1, i.e. Cb-1, wrap around in getMidiValue's unsigned short
+int signedMidiValue(unsigned short midi_value)
+{
+    return midi_value > 0x7FFF ? midi_value - 0x10000 : midi_value;
+}
+
+unsigned pitchClass(int midi_value)
+{
+    return static_cast<unsigned>((midi_value % 12 + 12) % 12);
+}
+} // namespace
+
+/**
+ * @brief Recognizes the chord formed by sounding pitches
+ *
+ * @param pitches Sounding pitches in any order, the lowest one is the bass
+ * @return ChordMatch see recognizeChord(PitchClassSet, unsigned)
+ */
+ChordMatch recognizeChord(const std::vector<Pitch> &pitches)
+{
+    PitchClassSet set;
+    int bass = std::numeric_limits<int>::max();
+    for (Pitch p : pitches)
+    {
+        int midi_value = signedMidiValue(p.getMidiValue());
+        set = set.with(pitchClass(midi_value));
+        bass = std::min(bass, midi_value);
+    }
+    return recognizeChord(set, pitchClass(bass));
+}
+
+/**
+ * @brief Recognizes the chord formed by an array of packed sounding pitches
+ *
+ * @param pitches Sounding pitches in any order, the lowest one is the bass
+ * @param count Number of pitches
+ * @return ChordMatch see recognizeChord(PitchClassSet, unsigned)
+ */
+ChordMatch recognizeChord(const PackedPitch *pitches, std::size_t count) noexcept
+{
+    PitchClassSet set;
+    int bass = std::numeric_limits<int>::max();
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        int midi_value = signedMidiValue(pitches[i].getMidiValue());
+        set = set.with(pitchClass(midi_value));
+        bass = std::min(bass, midi_value);
+    }
+    return recognizeChord(set, pitchClass(bass));
+}
+
+namespace
+{
+
+//! Adds a scale and all of its modes to a catalog, mode k starting on degree k of the scale.
+//! Each mode interval keeps the degree it spans in the parent scale, so modes keep their spelling
+void addScaleAndModes(std::vector<CatalogScale> &catalog, Scale scale, std::vector<const char *> mode_names)
+{
+    std::vector<unsigned short> semitones;
+    std::vector<unsigned short> degrees;
+    for (Interval interval : scale.getIntervalSpan())
+    {
+        semitones.push_back(interval.getSemitones());
+        degrees.push_back(interval.getDegree());
+    }
+    for (std::size_t mode = 0; mode < mode_names.size(); ++mode)
+    {
+        std::vector<Interval> intervals;
+        for (std::size_t degree = 0; degree < semitones.size(); ++degree)
+        {
+            std::size_t note = (mode + degree) % semitones.size();
+            auto above = (semitones[note] + 12 - semitones[mode]) % 12;
+            auto spanned = (degrees[note] + 7 - degrees[mode]) % 7 + 1;
+            intervals.push_back(Interval(static_cast<unsigned short>(above), static_cast<unsigned short>(spanned)));
+        }
+        Scale mode_scale = mode == 0 ? scale : Scale(intervals);
+        catalog.push_back({mode_names[mode], mode_scale, PitchClassSet(mode_scale)});
+    }
+}
+
+//! Pitch classes of every catalog scale on every root, stored contiguously for findScales
+struct ScaleIndex
+{
+    std::vector<std::uint16_t> masks;
+    std::vector<ScaleMatch> matches;
+};
+
+const ScaleIndex &scaleIndex()
+{
+    static const ScaleIndex index = [] {
+        ScaleIndex built;
+        for (const CatalogScale &entry : scaleCatalog())
+        {
+            for (unsigned root = 0; root < 12; ++root)
+            {
+                built.masks.push_back(entry.pitch_classes.transpose(static_cast<int>(root)).getMask());
+                built.matches.push_back({&entry, static_cast<std::uint8_t>(root)});
+            }
+        }
+        return built;
+    }();
+    return index;
+}
+
+//! One subset test per (scale, root) pair, appending matches to found whatever its allocator
+template <typename Vector> void collectScales(PitchClassSet pitch_classes, Vector &found)
+{
+    const ScaleIndex &index = scaleIndex();
+    std::uint16_t query = pitch_classes.getMask();
+    std::size_t count = 0;
+    for (std::uint16_t mask : index.masks)
+    {
+        count += (query & ~mask) == 0;
+    }
+
+    found.reserve(found.size() + count);
+    for (std::size_t i = 0; i < index.masks.size(); ++i)
+    {
+        if ((query & ~index.masks[i]) == 0)
+        {
+            found.push_back(index.matches[i]);
+        }
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Returns the catalog of named scales known to findScales
+ *
+ * @details Holds the modes of the major, melodic minor, harmonic minor and major
+ * pentatonic scales, plus the blues, whole tone, diminished and chromatic scales
+ *
+ * @return const std::vector<CatalogScale>&
+ */
+const std::vector<CatalogScale> &scaleCatalog()
+{
+    using namespace Intervals;
+    static const std::vector<CatalogScale> catalog = [] {
+        std::vector<CatalogScale> built;
+        addScaleAndModes(built, Scale({P1, M2, M3, P4, P5, M6, M7}),
+                         {"Ionian", "Dorian", "Phrygian", "Lydian", "Mixolydian", "Aeolian", "Locrian"});
+        addScaleAndModes(built, Scale({P1, M2, m3, P4, P5, M6, M7}),
+                         {"Melodic minor", "Dorian b2", "Lydian augmented", "Lydian dominant", "Mixolydian b6",
+                          "Locrian #2", "Altered"});
+        addScaleAndModes(built, Scale({P1, M2, m3, P4, P5, m6, M7}),
+                         {"Harmonic minor", "Locrian #6", "Ionian #5", "Dorian #4", "Phrygian dominant", "Lydian #2",
+                          "Altered bb7"});
+        addScaleAndModes(built, Scale({P1, M2, M3, P5, M6}),
+                         {"Major pentatonic", "Suspended pentatonic", "Blues minor pentatonic",
+                          "Blues major pentatonic", "Minor pentatonic"});
+        addScaleAndModes(built, Scale({P1, m3, P4, A4, P5, m7}), {"Blues"});
+        addScaleAndModes(built, Scale({P1, M2, M3, A4, m6, m7}), {"Whole tone"});
+        addScaleAndModes(built, Scale({P1, m2, m3, M3, A4, P5, M6, m7}),
+                         {"Half-whole diminished", "Whole-half diminished"});
+        addScaleAndModes(built, Scale({P1, m2, M2, m3, M3, P4, A4, P5, m6, M6, m7, M7}), {"Chromatic"});
+        return built;
+    }();
+    return catalog;
+}
+
+/**
+ * @brief Finds every catalog scale, on every root, that contains a set of pitch classes
+ *
+ * @details One subset test per (scale, root) pair over a contiguous array of 12 bit masks
+ *
+ * @param pitch_classes Absolute pitch classes, 0 being C
+ * @return std::vector<ScaleMatch> in catalog order, then by root
+ */
+std::vector<ScaleMatch> findScales(PitchClassSet pitch_classes)
+{
+    std::vector<ScaleMatch> found;
+    collectScales(pitch_classes, found);
+    return found;
+}
+
+/**
+ * @brief Finds every catalog scale, on every root, that contains a set of pitch classes
+ *
+ * @param pitch_classes Absolute pitch classes, 0 being C
+ * @param resource Memory resource backing the result, i.e. a per-request arena
+ * @return std::pmr::vector<ScaleMatch> see findScales(PitchClassSet)
+ */
+std::pmr::vector<ScaleMatch> findScales(PitchClassSet pitch_classes, std::pmr::memory_resource *resource)
+{
+    std::pmr::vector<ScaleMatch> found(resource);
+    collectScales(pitch_classes, found);
+    return found;
+}
+
+/**
+ * @brief Finds every catalog scale, on every root, that contains a set of pitches
+ *
+ * @param pitches Pitches in any octave
+ * @return std::vector<ScaleMatch> see findScales(PitchClassSet)
+ */
+std::vector<ScaleMatch> findScales(const std::vector<Pitch> &pitches)
+{
+    PitchClassSet set;
+    for (Pitch p : pitches)
+    {
+        set = set.with(p.getMidiValue());
+    }
+    return findScales(set);
+}
 
 } // namespace mt
\ No newline at end of file
@@ -24,14 +24,45 @@
 
 #pragma once
 
-#include <cmath>     // std::pow
-#include <stdexcept> // std::runtime_error
-#include <string>    // std::string
-#include <vector>    // std::vector
+#include <array>            // std::array
+#include <charconv>         // std::from_chars_result
+#include <cmath>            // std::pow
+#include <cstddef>          // std::size_t
+#include <cstdint>          // std::uint16_t, std::uint8_t
+#include <functional>       // std::hash
+#include <initializer_list> // std::initializer_list
+#include <memory_resource>  // std::pmr::memory_resource, std::pmr::vector
+#include <stdexcept>        // std::runtime_error
+#include <string>           // std::string
+#include <string_view>      // std::string_view
+#include <type_traits>      // std::is_trivially_copyable
+#include <vector>           // std::vector
 
 namespace mt
 {
 
+//! Exception for when a bad call for a new Pitch happens
+/*!
+  For example, asking for a Pitch out of range of the MIDI keyboard,
+  or trying to parse a Pitch with a garbage string
+*/
+class PitchParsingException : public std::runtime_error
+{
+  public:
+    PitchParsingException(char const *const message) throw() : std::runtime_error(message)
+    {
+    }
+};
+
+//! Exception for when a bad call for a new Interval happens
+class InvalidIntervalException : public std::runtime_error
+{
+  public:
+    InvalidIntervalException(char const *const message) throw() : std::runtime_error(message)
+    {
+    }
+};
+
 //! Primitive class used to hold the key type/name of a Pitch
 class Key
 {
@@ -48,9 +79,23 @@ class Key
         G
     };
 
-    Key(Type keyType = Type::C);
-    Type getType();
-    std::string toString();
+    constexpr Key(Type keyType = Type::C) noexcept : type(keyType)
+    {
+    }
+    constexpr Type getType() const noexcept
+    {
+        return type;
+    }
+    constexpr bool operator==(Key other) const noexcept
+    {
+        return type == other.type;
+    }
+    constexpr bool operator!=(Key other) const noexcept
+    {
+        return type != other.type;
+    }
+    std::string toString() const;
+    std::to_chars_result toChars(char *first, char *last) const noexcept;
 
   private:
     Type type; //! Stores the current type/name of this key
@@ -69,35 +114,406 @@ class Accidental
         double_sharp
     };
 
-    Accidental(Type t = Type::natural);
-    Type getType();
-    std::string toString();
+    //! Default constructor gives natural
+    constexpr Accidental(Type t = Type::natural) noexcept : type(t)
+    {
+    }
+    constexpr Type getType() const noexcept
+    {
+        return type;
+    }
+    constexpr bool operator==(Accidental other) const noexcept
+    {
+        return type == other.type;
+    }
+    constexpr bool operator!=(Accidental other) const noexcept
+    {
+        return type != other.type;
+    }
+    std::string toString() const;
+    std::to_chars_result toChars(char *first, char *last) const noexcept;
 
   private:
     Type type;
 };
 
+class PackedPitch;
+
 //! Class used to hold Pitch information.
 class Pitch
 {
   public:
-    Pitch(Key k = Key(Key::Type::C), Accidental a = Accidental(Accidental::Type::natural), unsigned short o = 4);
+    constexpr Pitch(Key k = Key(Key::Type::C), Accidental a = Accidental(Accidental::Type::natural),
+                    short o = 4) noexcept
+        : key(k), accidental(a), octave(o)
+    {
+    }
     Pitch(std::string val);
     Pitch(unsigned short midi_value, bool use_sharps = true);
+    constexpr explicit Pitch(PackedPitch p) noexcept;
 
-    Key getKey();
-    Accidental getAccidental();
-    unsigned short getOctave();
-    unsigned short getMidiValue();
-    double getFrequency();
-    std::string toString();
+    constexpr Key getKey() const noexcept
+    {
+        return key;
+    }
+    constexpr Accidental getAccidental() const noexcept
+    {
+        return accidental;
+    }
+    //! -1 for the lowest MIDI octave
+    constexpr short getOctave() const noexcept
+    {
+        return octave;
+    }
+    constexpr unsigned short getMidiValue() const noexcept;
+    constexpr double getFrequency() const noexcept;
+    std::string toString() const;
+    std::to_chars_result toChars(char *first, char *last) const noexcept;
+
+    //! Same spelling, so C#4 != Db4
+    constexpr bool operator==(const Pitch &other) const noexcept
+    {
+        return key == other.key && accidental == other.accidental && octave == other.octave;
+    }
+    constexpr bool operator!=(const Pitch &other) const noexcept
+    {
+        return !(*this == other);
+    }
+    //! Orders by sounding pitch, then by letter so that B#3 < C4 < Dbb4
+    constexpr bool operator<(const Pitch &other) const noexcept;
 
   private:
+    constexpr int signedMidiValue() const noexcept;
+
     Key key;
     Accidental accidental;
-    unsigned short octave;
+    short octave;
 };
 
+//! Frequency of A4 in hz that every Pitch frequency is tuned to
+inline constexpr double a4_frequency = 440.0;
+
+namespace detail
+{
+//! Semitones above C of each natural Key, indexed by Key::Type
+inline constexpr int key_semitones[] = {9, 11, 0, 2, 4, 5, 7};
+//! Semitone offset of each Accidental, indexed by Accidental::Type
+inline constexpr int accidental_semitones[] = {0, -1, 1, -2, 2};
+//! 2^(k/12) for k in [0, 12)
+inline constexpr double semitone_ratios[] = {1.0,
+                                             1.0594630943592953,
+                                             1.122462048309373,
+                                             1.189207115002721,
+                                             1.2599210498948732,
+                                             1.3348398541700344,
+                                             1.4142135623730951,
+                                             1.4983070768766815,
+                                             1.5874010519681996,
+                                             1.681792830507429,
+                                             1.7817974362806785,
+                                             1.887748625363387};
+
+//! Equal temperament frequency of any midi value, usable in constant expressions
+constexpr double frequencyFromMidi(int midi_value)
+{
+    int offset = midi_value - 69;
+    int octaves = offset >= 0 ? offset / 12 : -((11 - offset) / 12);
+    double frequency = a4_frequency * semitone_ratios[offset - 12 * octaves];
+    for (; octaves > 0; --octaves)
+    {
+        frequency *= 2;
+    }
+    for (; octaves < 0; ++octaves)
+    {
+        frequency /= 2;
+    }
+    return frequency;
+}
+
+//! Frequency of every midi value
+struct MidiFrequencyTable
+{
+    double frequencies[128];
+};
+
+constexpr MidiFrequencyTable makeMidiFrequencyTable()
+{
+    MidiFrequencyTable table{};
+    for (int midi_value = 0; midi_value < 128; ++midi_value)
+    {
+        table.frequencies[midi_value] = frequencyFromMidi(midi_value);
+    }
+    return table;
+}
+
+inline constexpr MidiFrequencyTable midi_frequencies = makeMidiFrequencyTable();
+} // namespace detail
+
+constexpr int Pitch::signedMidiValue() const noexcept
+{
+    return 12 * (octave + 1) + detail::key_semitones[static_cast<int>(key.getType())] +
+           detail::accidental_semitones[static_cast<int>(accidental.getType())];
+}
+
+constexpr unsigned short Pitch::getMidiValue() const noexcept
+{
+    return static_cast<unsigned short>(signedMidiValue());
+}
+
+constexpr bool Pitch::operator<(const Pitch &other) const noexcept
+{
+    int midi_value = signedMidiValue();
+    int other_midi_value = other.signedMidiValue();
+    if (midi_value != other_midi_value)
+    {
+        return midi_value < other_midi_value;
+    }
+    // Same sound: the lower letter is the one with the lower octave or the earlier letter from C
+    int letter = (static_cast<int>(key.getType()) + 5) % 7;
+    int other_letter = (static_cast<int>(other.key.getType()) + 5) % 7;
+    return octave != other.octave ? octave < other.octave : letter < other_letter;
+}
+
+//! Frequency in hz, looked up from a precomputed table for pitches in the MIDI range
+constexpr double Pitch::getFrequency() const noexcept
+{
+    auto midi_value = getMidiValue();
+    return midi_value < 128 ? detail::midi_frequencies.frequencies[midi_value]
+                            : detail::frequencyFromMidi(static_cast<short>(midi_value));
+}
+
+//! Compact 2 byte value type holding the same information as a Pitch.
+/*!
+  Bit layout, from least significant bit:
+  - bits 0-2: Accidental::Type
+  - bits 3-5: Key::Type
+  - bits 6-9: octave + 1, so octaves -1 to 14 fit
+
+  Meant for storing large arrays of pitches; convert to a Pitch when the
+  richer interface is needed.
+*/
+class PackedPitch
+{
+  public:
+    constexpr PackedPitch(Key::Type k = Key::Type::C, Accidental::Type a = Accidental::Type::natural, short o = 4)
+        : bits(static_cast<std::uint16_t>(((o + 1) & 0xF) << 6 | static_cast<unsigned>(k) << 3 |
+                                          static_cast<unsigned>(a)))
+    {
+    }
+    //! Octave of p must be between -1 and 14
+    constexpr explicit PackedPitch(Pitch p) noexcept
+        : PackedPitch(p.getKey().getType(), p.getAccidental().getType(), p.getOctave())
+    {
+    }
+
+    static constexpr PackedPitch fromMidi(std::uint8_t midi_value, bool use_sharps = true);
+
+    //! Builds a PackedPitch straight from its bit representation
+    static constexpr PackedPitch fromBits(std::uint16_t b)
+    {
+        PackedPitch p;
+        p.bits = b;
+        return p;
+    }
+
+    constexpr std::uint16_t getBits() const
+    {
+        return bits;
+    }
+    constexpr Key::Type getKeyType() const
+    {
+        return static_cast<Key::Type>(bits >> 3 & 0x7);
+    }
+    constexpr Accidental::Type getAccidentalType() const
+    {
+        return static_cast<Accidental::Type>(bits & 0x7);
+    }
+    constexpr short getOctave() const
+    {
+        return static_cast<short>((bits >> 6 & 0xF) - 1);
+    }
+    constexpr unsigned short getMidiValue() const
+    {
+        return static_cast<unsigned short>(signedMidiValue());
+    }
+    //! Frequency in hz, a single table load for pitches in the MIDI range
+    constexpr double getFrequency() const
+    {
+        int midi_value = signedMidiValue();
+        return midi_value >= 0 && midi_value < 128 ? detail::midi_frequencies.frequencies[midi_value]
+                                                   : detail::frequencyFromMidi(midi_value);
+    }
+    std::to_chars_result toChars(char *first, char *last) const;
+
+    constexpr bool operator==(PackedPitch other) const noexcept
+    {
+        return bits == other.bits;
+    }
+    constexpr bool operator!=(PackedPitch other) const noexcept
+    {
+        return bits != other.bits;
+    }
+    //! Same order as Pitch::operator<
+    constexpr bool operator<(PackedPitch other) const noexcept
+    {
+        int midi_value = signedMidiValue();
+        int other_midi_value = other.signedMidiValue();
+        if (midi_value != other_midi_value)
+        {
+            return midi_value < other_midi_value;
+        }
+        return Pitch(*this) < Pitch(other);
+    }
+
+  private:
+    constexpr int signedMidiValue() const
+    {
+        return 12 * (bits >> 6 & 0xF) + detail::key_semitones[bits >> 3 & 0x7] +
+               detail::accidental_semitones[bits & 0x7];
+    }
+
+    std::uint16_t bits;
+};
+
+static_assert(sizeof(PackedPitch) == 2, "PackedPitch must stay 2 bytes");
+static_assert(std::is_trivially_copyable<PackedPitch>::value, "PackedPitch must be trivially copyable");
+
+namespace detail
+{
+//! Sharp and flat spelling of every midi value
+struct MidiPitchTable
+{
+    PackedPitch sharps[128];
+    PackedPitch flats[128];
+};
+
+constexpr MidiPitchTable makeMidiPitchTable()
+{
+    constexpr Key::Type sharp_keys[] = {Key::Type::C, Key::Type::C, Key::Type::D, Key::Type::D,
+                                        Key::Type::E, Key::Type::F, Key::Type::F, Key::Type::G,
+                                        Key::Type::G, Key::Type::A, Key::Type::A, Key::Type::B};
+    constexpr Key::Type flat_keys[] = {Key::Type::C, Key::Type::D, Key::Type::D, Key::Type::E,
+                                       Key::Type::E, Key::Type::F, Key::Type::G, Key::Type::G,
+                                       Key::Type::A, Key::Type::A, Key::Type::B, Key::Type::B};
+    constexpr bool black_keys[] = {false, true, false, true, false, false, true, false, true, false, true, false};
+
+    MidiPitchTable table{};
+    for (int midi_value = 0; midi_value < 128; ++midi_value)
+    {
+        int r = midi_value % 12;
+        short octave = static_cast<short>(midi_value / 12 - 1);
+        table.sharps[midi_value] = PackedPitch(
+            sharp_keys[r], black_keys[r] ? Accidental::Type::sharp : Accidental::Type::natural, octave);
+        table.flats[midi_value] =
+            PackedPitch(flat_keys[r], black_keys[r] ? Accidental::Type::flat : Accidental::Type::natural, octave);
+    }
+    return table;
+}
+
+inline constexpr MidiPitchTable midi_pitches = makeMidiPitchTable();
+
+//! Text of a pitch name, i.e "C#-1", and its length
+struct PitchName
+{
+    char text[7];
+    unsigned char length;
+};
+
+//! Name of every PackedPitch, indexed by its 10 significant bits
+struct PitchNameTable
+{
+    PitchName names[1024];
+};
+
+constexpr PitchNameTable makePitchNameTable()
+{
+    constexpr char symbols[][3] = {"", "b", "#", "bb", "##"};
+    constexpr unsigned char symbol_lengths[] = {0, 1, 1, 2, 2, 0, 0, 0};
+
+    PitchNameTable table{};
+    for (unsigned bits = 0; bits < 1024; ++bits)
+    {
+        PitchName &name = table.names[bits];
+        unsigned key = bits >> 3 & 0x7;
+        unsigned accidental = bits & 0x7;
+        int octave = static_cast<int>(bits >> 6) - 1;
+
+        name.text[name.length++] = key < 7 ? "ABCDEFG"[key] : '?';
+        for (unsigned i = 0; i < symbol_lengths[accidental]; ++i)
+        {
+            name.text[name.length++] = symbols[accidental][i];
+        }
+        if (octave < 0)
+        {
+            name.text[name.length++] = '-';
+            octave = -octave;
+        }
+        if (octave >= 10)
+        {
+            name.text[name.length++] = '1';
+            octave -= 10;
+        }
+        name.text[name.length++] = static_cast<char>('0' + octave);
+    }
+    return table;
+}
+
+inline constexpr PitchNameTable pitch_names = makePitchNameTable();
+} // namespace detail
+
+//! Packed pitch of a midi value from a precomputed table, spelled with sharps or flats
+constexpr PackedPitch PackedPitch::fromMidi(std::uint8_t midi_value, bool use_sharps)
+{
+    return use_sharps ? detail::midi_pitches.sharps[midi_value & 0x7F] : detail::midi_pitches.flats[midi_value & 0x7F];
+}
+
+constexpr Pitch::Pitch(PackedPitch p) noexcept
+    : key(p.getKeyType()), accidental(p.getAccidentalType()), octave(p.getOctave())
+{
+}
+
+std::from_chars_result parsePitch(const char *first, const char *last, PackedPitch &value) noexcept;
+std::from_chars_result parsePitch(std::string_view str, PackedPitch &value) noexcept;
+
+//! Outcome of parsing a whole buffer of pitch names
+struct PitchBatchResult
+{
+    const char *ptr;   //!< Where parsing stopped, last on success
+    std::size_t count; //!< Number of values written to the output
+    std::errc ec;      //!< std::errc() on success
+};
+
+PitchBatchResult parsePitches(const char *first, const char *last, PackedPitch *out, std::size_t capacity) noexcept;
+PitchBatchResult parsePitches(const char *first, const char *last, std::uint8_t *midi_out,
+                              std::size_t capacity) noexcept;
+
+//! Outcome of formatting a whole array of pitches
+struct PitchFormatResult
+{
+    char *ptr;         //!< One past the last character of the last complete pitch written
+    std::size_t count; //!< Number of pitches written
+    std::errc ec;      //!< std::errc() on success
+};
+
+PitchFormatResult formatPitches(const PackedPitch *pitches, std::size_t count, char *first, char *last,
+                                char separator = ' ') noexcept;
+
+void midiToFrequencies(const std::uint8_t *midi_values, std::size_t count, double *frequencies) noexcept;
+void midiToFrequencies(const float *midi_values, std::size_t count, float *frequencies) noexcept;
+void frequenciesToMidi(const float *frequencies, std::size_t count, float *midi_values) noexcept;
+
+//! Nearest MIDI pitch to a frequency and how far off the frequency is
+struct PitchEstimate
+{
+    PackedPitch pitch;       //!< Nearest pitch in the MIDI range
+    std::uint8_t midi_value; //!< Midi value of pitch
+    float cents;             //!< Frequency minus pitch in cents, within [-50, 50] inside the MIDI range
+};
+
+PitchEstimate nearestPitch(double frequency, bool use_sharps = true) noexcept;
+void nearestPitches(const float *frequencies, std::size_t count, PitchEstimate *estimates,
+                    bool use_sharps = true) noexcept;
+
 //! Represents a generic interval.
 /*!
   Purely based on semitones since there is no root being taken into account.
@@ -111,91 +527,681 @@ class Interval
         major,
         minor,
         augmented,
-        dimished
+        dimished,
+        doubly_augmented,
+        doubly_diminished,
+        diminished = dimished
     };
-    Interval(Quality q = Quality::perfect, unsigned short degree = 1);
-    Interval(unsigned short semitones);
+    constexpr Interval(Quality q = Quality::perfect, unsigned short degree = 1);
+    constexpr Interval(unsigned short semitones);
+    constexpr Interval(unsigned short semitones, unsigned short degree);
 
-    Quality getQuality();
-    unsigned short getDegree();
-    unsigned short getSemitones();
-    Pitch getPitchFromRoot(Pitch root);
-    std::string toString();
+    constexpr Quality getQuality() const noexcept;
+    constexpr unsigned short getDegree() const noexcept;
+    constexpr unsigned short getSemitones() const noexcept;
+    Pitch getPitchFromRoot(Pitch root) const;
+    Pitch getSpelledPitchFromRoot(Pitch root) const;
+    std::string toString() const;
+    std::to_chars_result toChars(char *first, char *last) const;
+
+    constexpr bool operator==(Interval other) const noexcept
+    {
+        return quality == other.quality && degree == other.degree;
+    }
+    constexpr bool operator!=(Interval other) const noexcept
+    {
+        return !(*this == other);
+    }
+    //! Orders by semitones, then by degree so that A4 < d5
+    constexpr bool operator<(Interval other) const noexcept
+    {
+        return getSemitones() != other.getSemitones() ? getSemitones() < other.getSemitones()
+                                                      : degree < other.degree;
+    }
 
   private:
+    static constexpr Quality checkedQuality(Quality q, unsigned short degree);
+    static constexpr Quality spanningQuality(unsigned short semitones, unsigned short degree);
+
     Quality quality;
     unsigned short degree;
 };
 
-//! Holds a vector of intervals to form a generic scale.
+namespace detail
+{
+//! Marks a quality a simple degree can't have
+inline constexpr int no_interval = -100;
+
+//! Semitones of every simple interval, indexed by Interval::Quality then degree - 1
+inline constexpr int interval_semitones[7][7] = {
+    // 1              2            3            4            5            6            7
+    {0, no_interval, no_interval, 5, 7, no_interval, no_interval}, // perfect
+    {no_interval, 2, 4, no_interval, no_interval, 9, 11},          // major
+    {no_interval, 1, 3, no_interval, no_interval, 8, 10},          // minor
+    {1, 3, 5, 6, 8, 10, 12},                                       // augmented
+    {-1, 0, 2, 4, 6, 7, 9},                                        // diminished
+    {2, 4, 6, 7, 9, 11, 13},                                       // doubly augmented
+    {-2, -1, 1, 3, 5, 6, 8},                                       // doubly diminished
+};
+
+//! Semitones of the major or perfect simple interval of each degree, indexed by degree - 1
+inline constexpr int interval_references[7] = {0, 2, 4, 5, 7, 9, 11};
+
+//! Quality of every simple interval, indexed by degree - 1 then 3 + semitones above interval_references
+struct IntervalQualityTable
+{
+    signed char qualities[7][6];
+};
+
+constexpr IntervalQualityTable makeIntervalQualityTable()
+{
+    IntervalQualityTable table{};
+    for (int d = 0; d < 7; ++d)
+    {
+        for (int offset = 0; offset < 6; ++offset)
+        {
+            table.qualities[d][offset] = -1;
+        }
+        for (int q = 0; q < 7; ++q)
+        {
+            if (interval_semitones[q][d] != no_interval)
+            {
+                table.qualities[d][interval_semitones[q][d] - interval_references[d] + 3] = static_cast<signed char>(q);
+            }
+        }
+    }
+    return table;
+}
+
+inline constexpr IntervalQualityTable interval_qualities = makeIntervalQualityTable();
+
+//! Usual spelling of each simple semitone count, see Interval(unsigned short)
+inline constexpr Interval::Quality semitone_qualities[12] = {
+    Interval::Quality::perfect, Interval::Quality::minor,   Interval::Quality::major,     Interval::Quality::minor,
+    Interval::Quality::major,   Interval::Quality::perfect, Interval::Quality::augmented, Interval::Quality::perfect,
+    Interval::Quality::minor,   Interval::Quality::major,   Interval::Quality::minor,     Interval::Quality::major};
+inline constexpr unsigned short semitone_degrees[12] = {1, 2, 2, 3, 3, 4, 4, 5, 6, 6, 7, 7};
+} // namespace detail
+
+//! Throws InvalidIntervalException on bad construction calls, i.e. a major 4th
+//! or an interval below the root such as a diminished unison
+constexpr Interval::Interval(Quality q, unsigned short d) : quality(checkedQuality(q, d)), degree(d)
+{
+}
+
+//! Gives the usual spelling, i.e. 6 semitones is an augmented 4th
+constexpr Interval::Interval(unsigned short s)
+    : quality(detail::semitone_qualities[s % 12]),
+      degree(static_cast<unsigned short>(detail::semitone_degrees[s % 12] + 7 * (s / 12)))
+{
+}
+
+//! Picks whichever quality makes the degree span the semitones, so that
+//! Interval(i.getSemitones(), i.getDegree()) gives back i for every Interval i.
+//! Throws InvalidIntervalException if no quality does, i.e. 7 semitones over a 3rd
+constexpr Interval::Interval(unsigned short s, unsigned short d) : quality(spanningQuality(s, d)), degree(d)
+{
+}
+
+constexpr Interval::Quality Interval::getQuality() const noexcept
+{
+    return quality;
+}
+
+constexpr unsigned short Interval::getDegree() const noexcept
+{
+    return degree;
+}
+
+//! A single lookup in a table over quality and simple degree
+constexpr unsigned short Interval::getSemitones() const noexcept
+{
+    return static_cast<unsigned short>(detail::interval_semitones[static_cast<int>(quality)][(degree - 1) % 7] +
+                                       12 * ((degree - 1) / 7));
+}
+
+constexpr Interval::Quality Interval::checkedQuality(Quality q, unsigned short d)
+{
+    int simple_semitones = d < 1 ? detail::no_interval : detail::interval_semitones[static_cast<int>(q)][(d - 1) % 7];
+    if (simple_semitones == detail::no_interval || simple_semitones + 12 * ((d - 1) / 7) < 0)
+    {
+        throw InvalidIntervalException("Invalid interval error. Need valid quality and degree");
+    }
+    return q;
+}
+
+constexpr Interval::Quality Interval::spanningQuality(unsigned short s, unsigned short d)
+{
+    int q = -1;
+    if (d >= 1)
+    {
+        int simple = (d - 1) % 7;
+        int offset = s - 12 * ((d - 1) / 7) - detail::interval_references[simple] + 3;
+        if (offset >= 0 && offset < 6)
+        {
+            q = detail::interval_qualities.qualities[simple][offset];
+        }
+    }
+    if (q < 0)
+    {
+        throw InvalidIntervalException("Invalid interval error. No quality spans those semitones");
+    }
+    return static_cast<Quality>(q);
+}
+
+bool transpose(PackedPitch &pitch, Interval interval, bool up = true) noexcept;
+std::size_t transpose(PackedPitch *pitches, std::size_t count, Interval interval, bool up = true) noexcept;
+
+Interval intervalBetween(PackedPitch a, PackedPitch b, bool spelled = true);
+Interval intervalBetween(const Pitch &a, const Pitch &b, bool spelled = true);
+void melodicIntervals(const PackedPitch *pitches, std::size_t count, std::int16_t *semitones,
+                      std::int16_t *steps) noexcept;
+
+//! Non-owning view of a contiguous run of Intervals
+class IntervalSpan
+{
+  public:
+    constexpr IntervalSpan() noexcept : first(nullptr), count(0)
+    {
+    }
+    constexpr IntervalSpan(const Interval *data, std::size_t size) noexcept : first(data), count(size)
+    {
+    }
+    IntervalSpan(const std::vector<Interval> &intervals) noexcept : first(intervals.data()), count(intervals.size())
+    {
+    }
+
+    constexpr const Interval *data() const noexcept
+    {
+        return first;
+    }
+    constexpr std::size_t size() const noexcept
+    {
+        return count;
+    }
+    constexpr bool empty() const noexcept
+    {
+        return count == 0;
+    }
+    constexpr const Interval *begin() const noexcept
+    {
+        return first;
+    }
+    constexpr const Interval *end() const noexcept
+    {
+        return first + count;
+    }
+    constexpr const Interval &operator[](std::size_t i) const noexcept
+    {
+        return first[i];
+    }
+
+    //! Same intervals in the same order
+    constexpr bool operator==(IntervalSpan other) const noexcept
+    {
+        if (count != other.count)
+        {
+            return false;
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (first[i] != other.first[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    constexpr bool operator!=(IntervalSpan other) const noexcept
+    {
+        return !(*this == other);
+    }
+    //! Lexicographic over Interval::operator<
+    constexpr bool operator<(IntervalSpan other) const noexcept
+    {
+        for (std::size_t i = 0; i < count && i < other.count; ++i)
+        {
+            if (first[i] != other.first[i])
+            {
+                return first[i] < other.first[i];
+            }
+        }
+        return count < other.count;
+    }
+
+  private:
+    const Interval *first;
+    std::size_t count;
+};
+
+//! Fixed capacity list of Intervals stored inline, so Scale and Chord never allocate
+/*!
+  Trivially copyable; holding more than capacity intervals throws InvalidIntervalException
+*/
+class IntervalList
+{
+  public:
+    //! Enough for every note of the chromatic scale, with room for compound chord tones
+    static constexpr std::size_t capacity = 16;
+
+    constexpr IntervalList() noexcept : intervals(), count(0)
+    {
+    }
+    constexpr IntervalList(IntervalSpan span) : intervals(), count(0)
+    {
+        if (span.size() > capacity)
+        {
+            throw InvalidIntervalException("Invalid interval error. Too many intervals for a Scale or Chord");
+        }
+        for (const Interval &interval : span)
+        {
+            intervals[count++] = interval;
+        }
+    }
+
+    constexpr IntervalSpan span() const noexcept
+    {
+        return IntervalSpan(intervals, count);
+    }
+    constexpr std::size_t size() const noexcept
+    {
+        return count;
+    }
+
+  private:
+    Interval intervals[capacity];
+    std::uint8_t count;
+};
+
+//! Holds the intervals of a generic scale.
 class Scale
 {
   public:
-    Scale(std::vector<Interval> intervals);
+    Scale(std::initializer_list<Interval> intervals);
+    Scale(const std::vector<Interval> &intervals);
+    explicit Scale(IntervalSpan intervals);
 
-    std::vector<Interval> getIntervals();
+    std::vector<Interval> getIntervals() const;
+    std::pmr::vector<Interval> getIntervals(std::pmr::memory_resource *resource) const;
+    //! View of the intervals, valid for as long as the Scale is
+    IntervalSpan getIntervalSpan() const noexcept
+    {
+        return intervals.span();
+    }
 
-    std::vector<Pitch> getPitchesFromRoot(Pitch root);
+    std::vector<Pitch> getPitchesFromRoot(Pitch root) const;
+    std::pmr::vector<Pitch> getPitchesFromRoot(Pitch root, std::pmr::memory_resource *resource) const;
+
+    bool operator==(const Scale &other) const noexcept
+    {
+        return getIntervalSpan() == other.getIntervalSpan();
+    }
+    bool operator!=(const Scale &other) const noexcept
+    {
+        return getIntervalSpan() != other.getIntervalSpan();
+    }
+    bool operator<(const Scale &other) const noexcept
+    {
+        return getIntervalSpan() < other.getIntervalSpan();
+    }
 
   private:
-    std::vector<Interval> intervals;
+    IntervalList intervals;
 };
 
-//! Holds a vector of intervals to form a generic scale.
+//! Holds the intervals of a generic chord.
 class Chord
 {
   public:
-    Chord(std::vector<Interval> intervals);
+    Chord(std::initializer_list<Interval> intervals);
+    Chord(const std::vector<Interval> &intervals);
+    explicit Chord(IntervalSpan intervals);
+
+    std::vector<Interval> getIntervals() const;
+    std::pmr::vector<Interval> getIntervals(std::pmr::memory_resource *resource) const;
+    //! View of the intervals, valid for as long as the Chord is
+    IntervalSpan getIntervalSpan() const noexcept
+    {
+        return intervals.span();
+    }
 
-    std::vector<Interval> getIntervals();
+    std::vector<Pitch> getPitchesFromRoot(Pitch root) const;
+    std::pmr::vector<Pitch> getPitchesFromRoot(Pitch root, std::pmr::memory_resource *resource) const;
 
-    std::vector<Pitch> getPitchesFromRoot(Pitch root);
+    bool operator==(const Chord &other) const noexcept
+    {
+        return getIntervalSpan() == other.getIntervalSpan();
+    }
+    bool operator!=(const Chord &other) const noexcept
+    {
+        return getIntervalSpan() != other.getIntervalSpan();
+    }
+    bool operator<(const Chord &other) const noexcept
+    {
+        return getIntervalSpan() < other.getIntervalSpan();
+    }
 
   private:
-    std::vector<Interval> intervals;
+    IntervalList intervals;
 };
 
-//! Exception for when a bad call for a new Pitch happens
+//! Set of the 12 pitch classes held in a 12 bit mask.
 /*!
-  For example, asking for a Pitch out of range of the MIDI keyboard,
-  or trying to parse a Pitch with a garbage string
+  Bit n is set when the pitch class n semitones above the reference (the root
+  of a Scale or Chord, or C for absolute pitches) is in the set, so membership,
+  transposition, union and intersection are single bit operations.
 */
-class PitchParsingException : public std::runtime_error
+class PitchClassSet
 {
   public:
-    PitchParsingException(char const *const message) throw() : std::runtime_error(message)
+    constexpr PitchClassSet() : mask(0)
     {
     }
-};
+    constexpr explicit PitchClassSet(std::uint16_t m) : mask(m & 0xFFF)
+    {
+    }
+    explicit PitchClassSet(const Scale &s);
+    explicit PitchClassSet(const Chord &c);
 
-//! Exception for when a bad call for a new Interval happens
-class InvalidIntervalException : public std::runtime_error
-{
-  public:
-    InvalidIntervalException(char const *const message) throw() : std::runtime_error(message)
+    constexpr std::uint16_t getMask() const
     {
+        return mask;
     }
+    constexpr bool contains(unsigned pitch_class) const
+    {
+        return mask >> (pitch_class % 12) & 1;
+    }
+    constexpr PitchClassSet with(unsigned pitch_class) const
+    {
+        return PitchClassSet(static_cast<std::uint16_t>(mask | 1u << (pitch_class % 12)));
+    }
+    constexpr unsigned size() const
+    {
+        // Three nibble lookups; __builtin_popcount is a library call without -mpopcnt
+        constexpr unsigned char nibble_sizes[] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+        return nibble_sizes[mask & 0xF] + nibble_sizes[mask >> 4 & 0xF] + nibble_sizes[mask >> 8];
+    }
+    constexpr bool empty() const
+    {
+        return mask == 0;
+    }
+    //! Moves every pitch class up by semitones (down if negative), a 12 bit rotate
+    constexpr PitchClassSet transpose(int semitones) const
+    {
+        unsigned n = static_cast<unsigned>((semitones % 12 + 12) % 12);
+        return PitchClassSet(static_cast<std::uint16_t>(mask << n | mask >> (12 - n)));
+    }
+    constexpr bool isSubsetOf(PitchClassSet other) const
+    {
+        return (mask & ~other.mask) == 0;
+    }
+
+    constexpr PitchClassSet operator|(PitchClassSet other) const
+    {
+        return PitchClassSet(static_cast<std::uint16_t>(mask | other.mask));
+    }
+    constexpr PitchClassSet operator&(PitchClassSet other) const
+    {
+        return PitchClassSet(static_cast<std::uint16_t>(mask & other.mask));
+    }
+    constexpr PitchClassSet operator^(PitchClassSet other) const
+    {
+        return PitchClassSet(static_cast<std::uint16_t>(mask ^ other.mask));
+    }
+    constexpr PitchClassSet operator~() const
+    {
+        return PitchClassSet(static_cast<std::uint16_t>(~mask));
+    }
+    constexpr bool operator==(PitchClassSet other) const
+    {
+        return mask == other.mask;
+    }
+    constexpr bool operator!=(PitchClassSet other) const
+    {
+        return mask != other.mask;
+    }
+
+    Scale toScale() const;
+    Chord toChord() const;
+
+  private:
+    std::uint16_t mask;
+};
+
+//! Chord recognized from a set of sounding pitches by recognizeChord
+struct ChordMatch
+{
+    bool found;                //!< false when no known chord fits the pitches
+    bool exact;                //!< true when every sounding pitch class is a chord tone
+    std::uint8_t root;         //!< Pitch class of the root, 0 being C
+    std::uint8_t inversion;    //!< 0 in root position, 1 with the 3rd in the bass, ...; 0 if the bass is no chord tone
+    const char *name;          //!< Chord symbol without the root, i.e "m7"
+    PitchClassSet chord_tones; //!< Chord tones relative to the root
+
+    Chord getChord() const;
+};
+
+ChordMatch recognizeChord(PitchClassSet pitch_classes, unsigned bass_pitch_class) noexcept;
+ChordMatch recognizeChord(const std::vector<Pitch> &pitches);
+ChordMatch recognizeChord(const PackedPitch *pitches, std::size_t count) noexcept;
+
+//! Named Scale of the scale catalog
+struct CatalogScale
+{
+    const char *name;            //!< i.e "Dorian"
+    Scale scale;                 //!< Intervals from the root
+    PitchClassSet pitch_classes; //!< Pitch classes relative to the root
+};
+
+//! Scale of the catalog on a specific root, as found by findScales
+struct ScaleMatch
+{
+    const CatalogScale *scale; //!< Entry of scaleCatalog()
+    std::uint8_t root;         //!< Pitch class of the root, 0 being C
 };
 
+const std::vector<CatalogScale> &scaleCatalog();
+std::vector<ScaleMatch> findScales(PitchClassSet pitch_classes);
+std::pmr::vector<ScaleMatch> findScales(PitchClassSet pitch_classes, std::pmr::memory_resource *resource);
+std::vector<ScaleMatch> findScales(const std::vector<Pitch> &pitches);
+
 /**
  * @brief Simple intervals for convenience
  *
  */
 namespace Intervals
 {
-extern Interval P1;
-extern Interval m2;
-extern Interval M2;
-extern Interval m3;
-extern Interval M3;
-extern Interval P4;
-extern Interval A4;
-extern Interval P5;
-extern Interval m6;
-extern Interval M6;
-extern Interval m7;
-extern Interval M7;
-extern Interval P8;
+inline constexpr Interval P1(Interval::Quality::perfect, 1);
+inline constexpr Interval m2(Interval::Quality::minor, 2);
+inline constexpr Interval M2(Interval::Quality::major, 2);
+inline constexpr Interval m3(Interval::Quality::minor, 3);
+inline constexpr Interval M3(Interval::Quality::major, 3);
+inline constexpr Interval P4(Interval::Quality::perfect, 4);
+inline constexpr Interval A4(Interval::Quality::augmented, 4);
+inline constexpr Interval d5(Interval::Quality::diminished, 5);
+inline constexpr Interval P5(Interval::Quality::perfect, 5);
+inline constexpr Interval A5(Interval::Quality::augmented, 5);
+inline constexpr Interval m6(Interval::Quality::minor, 6);
+inline constexpr Interval M6(Interval::Quality::major, 6);
+inline constexpr Interval d7(Interval::Quality::diminished, 7);
+inline constexpr Interval m7(Interval::Quality::minor, 7);
+inline constexpr Interval M7(Interval::Quality::major, 7);
+inline constexpr Interval P8(Interval::Quality::perfect, 8);
 } // namespace Intervals
 
+namespace detail
+{
+//! Everything StaticScale and StaticChord know about their intervals, worked out at compile time
+template <const Interval &...Is> struct StaticIntervals
+{
+    static_assert(sizeof...(Is) > 0, "Need at least one interval");
+
+    static constexpr std::size_t size = sizeof...(Is);
+    static constexpr Interval intervals[] = {Is...};
+    static constexpr unsigned short semitones[] = {Is.getSemitones()...};
+    //! Pitch classes relative to the root, as PitchClassSet(Scale) or PitchClassSet(Chord) would give
+    static constexpr PitchClassSet pitch_classes =
+        PitchClassSet(static_cast<std::uint16_t>((0u | ... | (1u << Is.getSemitones() % 12))));
+
+    //! Absolute pitch classes on a root pitch class, 0 being C
+    static constexpr PitchClassSet pitchClassesFromRoot(unsigned root)
+    {
+        return pitch_classes.transpose(static_cast<int>(root % 12));
+    }
+
+    //! Same pitches as getPitchesFromRoot on a Scale or Chord, but without allocating.
+    //! Throws PitchParsingException if a pitch would be out of the MIDI range
+    static constexpr std::array<PackedPitch, size> getPitchesFromRoot(PackedPitch root, bool use_sharps = true)
+    {
+        std::array<PackedPitch, size> pitches{};
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            unsigned midi_value = root.getMidiValue() + semitones[i];
+            if (midi_value > 127)
+            {
+                throw PitchParsingException("Cannot make pitch out of range of the MIDI keyboard");
+            }
+            pitches[i] = PackedPitch::fromMidi(static_cast<std::uint8_t>(midi_value), use_sharps);
+        }
+        return pitches;
+    }
+};
+} // namespace detail
+
+//! Scale whose intervals are template arguments, so it is fully known at compile time.
+/*!
+  The arguments are constexpr Intervals with static storage, such as the Intervals::
+  constants, i.e. StaticScale<Intervals::P1, Intervals::M2, Intervals::M3, ...>
+*/
+template <const Interval &...Is> struct StaticScale : detail::StaticIntervals<Is...>
+{
+    static Scale toScale()
+    {
+        return Scale({Is...});
+    }
+};
+
+//! Chord whose intervals are template arguments, so it is fully known at compile time.
+/*!
+  The arguments are constexpr Intervals with static storage, such as the Intervals::
+  constants, i.e. StaticChord<Intervals::P1, Intervals::M3, Intervals::P5>
+*/
+template <const Interval &...Is> struct StaticChord : detail::StaticIntervals<Is...>
+{
+    static Chord toChord()
+    {
+        return Chord({Is...});
+    }
+};
+
+/**
+ * @brief Common chords, evaluated at compile time
+ *
+ */
+namespace Chords
+{
+using major = StaticChord<Intervals::P1, Intervals::M3, Intervals::P5>;
+using minor = StaticChord<Intervals::P1, Intervals::m3, Intervals::P5>;
+using diminished = StaticChord<Intervals::P1, Intervals::m3, Intervals::d5>;
+using augmented = StaticChord<Intervals::P1, Intervals::M3, Intervals::A5>;
+using dominant7 = StaticChord<Intervals::P1, Intervals::M3, Intervals::P5, Intervals::m7>;
+using major7 = StaticChord<Intervals::P1, Intervals::M3, Intervals::P5, Intervals::M7>;
+using minor7 = StaticChord<Intervals::P1, Intervals::m3, Intervals::P5, Intervals::m7>;
+using half_diminished7 = StaticChord<Intervals::P1, Intervals::m3, Intervals::d5, Intervals::m7>;
+using diminished7 = StaticChord<Intervals::P1, Intervals::m3, Intervals::d5, Intervals::d7>;
+} // namespace Chords
+
+/**
+ * @brief Common scales, evaluated at compile time
+ *
+ */
+namespace Scales
+{
+using major = StaticScale<Intervals::P1, Intervals::M2, Intervals::M3, Intervals::P4, Intervals::P5, Intervals::M6,
+                          Intervals::M7>;
+using natural_minor = StaticScale<Intervals::P1, Intervals::M2, Intervals::m3, Intervals::P4, Intervals::P5,
+                                  Intervals::m6, Intervals::m7>;
+using harmonic_minor = StaticScale<Intervals::P1, Intervals::M2, Intervals::m3, Intervals::P4, Intervals::P5,
+                                   Intervals::m6, Intervals::M7>;
+using melodic_minor = StaticScale<Intervals::P1, Intervals::M2, Intervals::m3, Intervals::P4, Intervals::P5,
+                                  Intervals::M6, Intervals::M7>;
+using major_pentatonic = StaticScale<Intervals::P1, Intervals::M2, Intervals::M3, Intervals::P5, Intervals::M6>;
+using minor_pentatonic = StaticScale<Intervals::P1, Intervals::m3, Intervals::P4, Intervals::P5, Intervals::m7>;
+} // namespace Scales
+
+namespace detail
+{
+//! Distinct small integer for every Interval, so hashing one needs no mixing
+constexpr std::size_t intervalCode(Interval interval) noexcept
+{
+    return static_cast<std::size_t>(interval.getDegree()) << 3 | static_cast<std::size_t>(interval.getQuality());
+}
+
+//! FNV-1a over the interval codes
+constexpr std::size_t hashIntervals(IntervalSpan intervals) noexcept
+{
+    std::uint64_t h = 14695981039346656037ull;
+    for (Interval interval : intervals)
+    {
+        h = (h ^ intervalCode(interval)) * 1099511628211ull;
+    }
+    return static_cast<std::size_t>(h);
+}
+} // namespace detail
+
 } // namespace mt
+
+namespace std
+{
+//! Hashes are the packed encodings where those fit in a std::size_t, so equal values
+//! hash equal and distinct pitches and intervals never collide
+template <> struct hash<mt::Pitch>
+{
+    std::size_t operator()(const mt::Pitch &p) const noexcept
+    {
+        return static_cast<std::size_t>(static_cast<std::uint16_t>(p.getOctave())) << 6 |
+               static_cast<std::size_t>(p.getKey().getType()) << 3 |
+               static_cast<std::size_t>(p.getAccidental().getType());
+    }
+};
+
+template <> struct hash<mt::PackedPitch>
+{
+    std::size_t operator()(mt::PackedPitch p) const noexcept
+    {
+        return p.getBits();
+    }
+};
+
+template <> struct hash<mt::Interval>
+{
+    std::size_t operator()(mt::Interval i) const noexcept
+    {
+        return mt::detail::intervalCode(i);
+    }
+};
+
+template <> struct hash<mt::Scale>
+{
+    std::size_t operator()(const mt::Scale &s) const noexcept
+    {
+        return mt::detail::hashIntervals(s.getIntervalSpan());
+    }
+};
+
+template <> struct hash<mt::Chord>
+{
+    std::size_t operator()(const mt::Chord &c) const noexcept
+    {
+        return mt::detail::hashIntervals(c.getIntervalSpan());
+    }
+};
+
+template <> struct hash<mt::PitchClassSet>
+{
+    std::size_t operator()(mt::PitchClassSet s) const noexcept
+    {
+        return s.getMask();
+    }
+};
+} // namespace std
@@ -0,0 +1,203 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#include "thread_pool.hpp"
+
+#include <algorithm> // std::max
+
+namespace mt
+{
+
+/**
+ * @brief Starts the pool's threads, all but worker 0
+ *
+ * @details If a thread fails to start, the ones already running are stopped and
+ * joined before the exception propagates
+ *
+ * @param count Number of workers, counting the thread that calls run, or 0 for one
+ * per hardware thread
+ */
+ThreadPool::ThreadPool(std::size_t count)
+{
+    if (count == 0)
+    {
+        count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    threads.reserve(count - 1);
+    try
+    {
+        for (std::size_t i = 1; i < count; ++i)
+        {
+            threads.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+    catch (...)
+    {
+        stop();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+//! Wakes every started thread so it returns, then joins it
+void ThreadPool::stop() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Calls task once for every index in [0, count) and waits for them all
+ *
+ * @details Indices are split into one contiguous block per worker, then rebalanced by
+ * stealing. If a task throws, workers stop picking up new tasks, and once the running
+ * ones finish the first exception is rethrown here
+ *
+ * @param count Number of tasks
+ * @param task Called with the task index and the index of the worker running it, which
+ * is below size() and can pick per-thread state
+ */
+void ThreadPool::run(std::size_t count, const std::function<void(std::size_t task, std::size_t worker)> &task)
+{
+    const std::size_t workers = size();
+    for (std::size_t w = 0; w < workers; ++w)
+    {
+        std::lock_guard<std::mutex> lock(queues[w]->mutex);
+        queues[w]->tasks.clear(); // Left over if the last batch failed
+        for (std::size_t i = count * w / workers; i < count * (w + 1) / workers; ++i)
+        {
+            queues[w]->tasks.push_back(i);
+        }
+    }
+    failed = false;
+    error = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = &task;
+        active = threads.size();
+        ++batch;
+    }
+    wake.notify_all();
+
+    drain(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return active == 0; });
+    current = nullptr;
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop(std::size_t worker)
+{
+    std::size_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || batch != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = batch;
+        }
+        drain(worker);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0)
+            {
+                finished.notify_one();
+            }
+        }
+    }
+}
+
+//! Runs tasks on behalf of worker until no queue has any left
+void ThreadPool::drain(std::size_t worker)
+{
+    std::size_t task;
+    while (next(worker, task))
+    {
+        try
+        {
+            (*current)(task, worker);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+            failed = true;
+        }
+    }
+}
+
+//! Pops the worker's own newest task, or steals the oldest from another worker
+bool ThreadPool::next(std::size_t worker, std::size_t &task)
+{
+    const std::size_t workers = size();
+    for (std::size_t k = 0; k < workers && !failed; ++k)
+    {
+        Queue &queue = *queues[(worker + k) % workers];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+        if (k == 0)
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+} // namespace mt
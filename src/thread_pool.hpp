@@ -0,0 +1,92 @@
+/*
+    MIT License
+
+    Copyright (c) 2020 Mason Dructor
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+   deal in the Software without restriction, including without limitation the
+   rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+   sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+   all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+   FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+   IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>             // std::atomic
+#include <condition_variable> // std::condition_variable
+#include <cstddef>            // std::size_t
+#include <deque>              // std::deque
+#include <exception>          // std::exception_ptr
+#include <functional>         // std::function
+#include <memory>             // std::unique_ptr
+#include <mutex>              // std::mutex
+#include <thread>             // std::thread
+#include <vector>             // std::vector
+
+namespace mt
+{
+
+//! Fixed set of threads running batches of indexed tasks, balanced by work stealing
+/*!
+  run hands each worker a contiguous block of task indices in its own queue. A worker
+  pops from the back of its queue, and once that's empty steals from the front of the
+  others', so uneven tasks, like files of very different lengths, still keep every
+  thread busy. The calling thread works as worker 0, so a pool of size 1 starts no
+  threads at all. Batches run one at a time; run must not be called from inside a task.
+*/
+class ThreadPool
+{
+  public:
+    //! count == 0 sizes the pool to std::thread::hardware_concurrency
+    explicit ThreadPool(std::size_t count = 0);
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    std::size_t size() const noexcept
+    {
+        return queues.size();
+    }
+
+    void run(std::size_t count, const std::function<void(std::size_t task, std::size_t worker)> &task);
+
+  private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void stop() noexcept;
+    void workerLoop(std::size_t worker);
+    void drain(std::size_t worker);
+    bool next(std::size_t worker, std::size_t &task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    const std::function<void(std::size_t, std::size_t)> *current = nullptr;
+    std::size_t batch = 0;  //!< Incremented for every call to run
+    std::size_t active = 0; //!< Threads still working on the current batch
+    bool stopping = false;
+
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+};
+
+} // namespace mt
@@ -22,10 +22,26 @@
    IN THE SOFTWARE.
 */
 
-#define CATCH_CONFIG_MAIN // tells Catch to provide a main()
+#define CATCH_CONFIG_MAIN             // tells Catch to provide a main()
+#define CATCH_CONFIG_NO_POSIX_SIGNALS // MINSIGSTKSZ is no longer a constant on newer glibc
+#include "../src/corpus.hpp"
+#include "../src/events.hpp"
+#include "../src/midi.hpp"
+#include "../src/thread_pool.hpp"
 #include "../src/mt.hpp"
 #include "catch.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+
 TEST_CASE("Keys can be made of different types", "[Key]")
 {
     REQUIRE(mt::Key(mt::Key::Type::A).toString() == "A");
@@ -65,6 +81,355 @@ TEST_CASE("Pitches can be used to get more information", "[Pitch]")
     REQUIRE(p.getFrequency() == Approx(233.08));
 }
 
+TEST_CASE("Pitches can be packed into 2 bytes and back", "[PackedPitch]")
+{
+    constexpr mt::PackedPitch bb3(mt::Key::Type::B, mt::Accidental::Type::flat, 3);
+    static_assert(bb3.getMidiValue() == 58, "constexpr midi value");
+    static_assert(bb3.getOctave() == 3, "constexpr octave");
+    REQUIRE(sizeof(mt::PackedPitch) == 2);
+    REQUIRE(mt::Pitch(bb3).toString() == "Bb3");
+
+    mt::Pitch p("F##7");
+    mt::PackedPitch packed(p);
+    REQUIRE(packed.getKeyType() == mt::Key::Type::F);
+    REQUIRE(packed.getAccidentalType() == mt::Accidental::Type::double_sharp);
+    REQUIRE(packed.getMidiValue() == p.getMidiValue());
+    REQUIRE(mt::PackedPitch::fromBits(packed.getBits()).getBits() == packed.getBits());
+    REQUIRE(mt::Pitch(packed).toString() == "F##7");
+}
+
+TEST_CASE("Pitch strings can be parsed without exceptions", "[Pitch]")
+{
+    mt::PackedPitch p;
+    std::string_view text = "C#4 rest";
+    auto result = mt::parsePitch(text, p);
+    REQUIRE(result.ec == std::errc());
+    REQUIRE(result.ptr == text.data() + 3);
+    REQUIRE(mt::Pitch(p).toString() == "C#4");
+
+    REQUIRE(mt::parsePitch("bb2", p).ec == std::errc());
+    REQUIRE(mt::Pitch(p).toString() == "Bb2");
+    REQUIRE(mt::parsePitch("b#2", p).ec == std::errc());
+    REQUIRE(mt::Pitch(p).toString() == "B#2");
+
+    for (auto bad : {"", "H4", "C", "Cb#4", "C###4", "#4"})
+    {
+        auto failed = mt::parsePitch(bad, p);
+        REQUIRE(failed.ec == std::errc::invalid_argument);
+        REQUIRE(failed.ptr == bad);
+    }
+    REQUIRE_THROWS_AS(mt::Pitch("C10"), mt::PitchParsingException);
+    REQUIRE_THROWS_AS(mt::Pitch("Cbb#4"), mt::PitchParsingException);
+}
+
+TEST_CASE("Buffers of pitch names can be parsed in bulk", "[Pitch]")
+{
+    std::string names[] = {"C#4", "Bb3", "e5", "F##2", "gbb7", "A0", "b#1", "Db6", "G9", "c4"};
+    std::string text = " ";
+    for (int i = 0; i < 20; ++i)
+    {
+        text += names[i % 10] + (i % 3 == 0 ? ",\n\t" : " ");
+    }
+
+    mt::PackedPitch pitches[32];
+    auto result = mt::parsePitches(text.data(), text.data() + text.size(), pitches, 32);
+    REQUIRE(result.ec == std::errc());
+    REQUIRE(result.count == 20);
+    for (int i = 0; i < 20; ++i)
+    {
+        REQUIRE(mt::Pitch(pitches[i]).toString() == mt::Pitch(names[i % 10]).toString());
+    }
+
+    std::uint8_t midi[32];
+    result = mt::parsePitches(text.data(), text.data() + text.size(), midi, 32);
+    REQUIRE(result.count == 20);
+    REQUIRE(midi[0] == 61);
+    REQUIRE(midi[1] == 58);
+
+    result = mt::parsePitches(text.data(), text.data() + text.size(), pitches, 4);
+    REQUIRE(result.ec == std::errc::value_too_large);
+    REQUIRE(result.count == 4);
+
+    std::string bad = "C4 D4 Cb#4 E4";
+    result = mt::parsePitches(bad.data(), bad.data() + bad.size(), pitches, 32);
+    REQUIRE(result.ec == std::errc::invalid_argument);
+    REQUIRE(result.count == 2);
+    REQUIRE(result.ptr == bad.data() + 6);
+
+    // Every short token must be accepted or rejected exactly like Pitch(std::string),
+    // both in the vectorized part of the buffer and in its tail
+    const char alphabet[] = "Ccb#4x";
+    std::string padding(70, ' ');
+    for (int code = 0; code < 6 * 6 * 6 * 6 * 6; ++code)
+    {
+        std::string token;
+        for (int c = code; c; c /= 6)
+        {
+            token += alphabet[c % 6];
+        }
+        bool valid = true;
+        std::string expected;
+        try
+        {
+            expected = mt::Pitch(token).toString();
+        }
+        catch (mt::PitchParsingException &)
+        {
+            valid = false;
+        }
+        for (auto buffer : {token + padding, padding + token})
+        {
+            result = mt::parsePitches(buffer.data(), buffer.data() + buffer.size(), pitches, 32);
+            REQUIRE((result.ec == std::errc()) == (valid || token.empty()));
+            if (valid)
+            {
+                REQUIRE(result.count == 1);
+                REQUIRE(mt::Pitch(pitches[0]).toString() == expected);
+            }
+        }
+    }
+
+    std::string high = "G9 G##9";
+    result = mt::parsePitches(high.data(), high.data() + high.size(), midi, 32);
+    REQUIRE(result.ec == std::errc::result_out_of_range);
+    REQUIRE(result.count == 1);
+}
+
+TEST_CASE("Pitches and intervals can be written into caller buffers", "[Pitch]")
+{
+    char buffer[8];
+    auto result = mt::Pitch("F##7").toChars(buffer, buffer + sizeof(buffer));
+    REQUIRE(result.ec == std::errc());
+    REQUIRE(std::string(buffer, result.ptr) == "F##7");
+    REQUIRE(mt::Pitch("F##7").toChars(buffer, buffer + 3).ec == std::errc::value_too_large);
+
+    result = mt::PackedPitch(mt::Key::Type::B, mt::Accidental::Type::flat, 3).toChars(buffer, buffer + 3);
+    REQUIRE(std::string(buffer, result.ptr) == "Bb3");
+    result = mt::Interval(mt::Interval::Quality::minor, 10).toChars(buffer, buffer + sizeof(buffer));
+    REQUIRE(std::string(buffer, result.ptr) == "m10");
+    result = mt::Key(mt::Key::Type::G).toChars(buffer, buffer + 1);
+    REQUIRE(std::string(buffer, result.ptr) == "G");
+    result = mt::Accidental().toChars(buffer, buffer);
+    REQUIRE(result.ec == std::errc());
+    REQUIRE(result.ptr == buffer);
+
+    mt::PackedPitch pitches[] = {mt::PackedPitch(), mt::PackedPitch(mt::Key::Type::D, mt::Accidental::Type::sharp, 5),
+                                 mt::PackedPitch(mt::Key::Type::E, mt::Accidental::Type::double_flat, 2)};
+    char csv[32];
+    auto formatted = mt::formatPitches(pitches, 3, csv, csv + sizeof(csv), ',');
+    REQUIRE(formatted.ec == std::errc());
+    REQUIRE(formatted.count == 3);
+    REQUIRE(std::string(csv, formatted.ptr) == "C4,D#5,Ebb2");
+
+    formatted = mt::formatPitches(pitches, 3, csv, csv + 8, ',');
+    REQUIRE(formatted.ec == std::errc::value_too_large);
+    REQUIRE(formatted.count == 2);
+    REQUIRE(std::string(csv, formatted.ptr) == "C4,D#5");
+}
+
+TEST_CASE("Every MIDI value maps to a Pitch, frequency and name", "[Pitch]")
+{
+    REQUIRE(mt::Pitch(0).toString() == "C-1");
+    REQUIRE(mt::Pitch(1, false).toString() == "Db-1");
+    REQUIRE(mt::Pitch(127).toString() == "G9");
+    REQUIRE(mt::Pitch(70, false).toString() == "Bb4");
+    REQUIRE_THROWS_AS(mt::Pitch(128), mt::PitchParsingException);
+    REQUIRE(mt::Pitch("C#-1").getMidiValue() == 1);
+
+    static_assert(mt::PackedPitch::fromMidi(69).getFrequency() == 440.0, "A4 is the reference");
+    for (unsigned short midi = 0; midi < 128; ++midi)
+    {
+        mt::Pitch sharp(midi);
+        mt::Pitch flat(midi, false);
+        REQUIRE(sharp.getMidiValue() == midi);
+        REQUIRE(flat.getMidiValue() == midi);
+        REQUIRE(mt::Pitch(sharp.toString()).getMidiValue() == midi);
+        REQUIRE(sharp.getFrequency() == Approx(440 * std::pow(2, (midi - 69) / 12.0)));
+        REQUIRE(mt::PackedPitch::fromMidi(midi, false).getFrequency() == sharp.getFrequency());
+    }
+}
+
+TEST_CASE("MIDI values and frequencies can be converted in bulk", "[Pitch]")
+{
+    std::uint8_t notes[128];
+    double exact[128];
+    for (int i = 0; i < 128; ++i)
+    {
+        notes[i] = static_cast<std::uint8_t>(i);
+    }
+    mt::midiToFrequencies(notes, 128, exact);
+    for (unsigned short i = 0; i < 128; ++i)
+    {
+        REQUIRE(exact[i] == mt::Pitch(i).getFrequency());
+    }
+
+    std::vector<float> bent;
+    for (float m = -10; m < 140; m += 0.037f)
+    {
+        bent.push_back(m);
+    }
+    std::vector<float> frequencies(bent.size()), back(bent.size());
+    mt::midiToFrequencies(bent.data(), bent.size(), frequencies.data());
+    mt::frequenciesToMidi(frequencies.data(), frequencies.size(), back.data());
+    for (std::size_t i = 0; i < bent.size(); ++i)
+    {
+        double expected = 440 * std::pow(2.0, (bent[i] - 69.0) / 12);
+        REQUIRE(std::fabs(1200 * std::log2(frequencies[i] / expected)) < 0.002);
+        double expected_midi = 69 + 12 * std::log2(frequencies[i] / 440.0);
+        REQUIRE(std::fabs(100 * (back[i] - expected_midi)) < 0.002);
+    }
+
+    float invalid[] = {0.0f, -440.0f, 440.0f, 0.0f, 880.0f};
+    float midi[5];
+    mt::frequenciesToMidi(invalid, 5, midi);
+    REQUIRE(std::isnan(midi[0]));
+    REQUIRE(std::isnan(midi[1]));
+    REQUIRE(midi[2] == Approx(69));
+    REQUIRE(std::isnan(midi[3]));
+    REQUIRE(midi[4] == Approx(81));
+
+    // Both the 4 wide path and the scalar tail pass NaN through
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    float bent_invalid[] = {nan, 69.0f, 81.0f, nan, nan};
+    float hz[5];
+    mt::midiToFrequencies(bent_invalid, 5, hz);
+    REQUIRE(std::isnan(hz[0]));
+    REQUIRE(hz[1] == Approx(440));
+    REQUIRE(hz[2] == Approx(880));
+    REQUIRE(std::isnan(hz[3]));
+    REQUIRE(std::isnan(hz[4]));
+}
+
+TEST_CASE("Frequencies can be mapped back to the nearest Pitch", "[Pitch]")
+{
+    auto a4 = mt::nearestPitch(440.0);
+    REQUIRE(mt::Pitch(a4.pitch).toString() == "A4");
+    REQUIRE(a4.midi_value == 69);
+    REQUIRE(a4.cents == Approx(0).margin(0.002));
+
+    auto sharp = mt::nearestPitch(440.0 * std::pow(2.0, 20 / 1200.0), false);
+    REQUIRE(sharp.midi_value == 69);
+    REQUIRE(sharp.cents == Approx(20).margin(0.002));
+    auto flat = mt::nearestPitch(mt::Pitch("A#4").getFrequency() * std::pow(2.0, -30 / 1200.0), false);
+    REQUIRE(mt::Pitch(flat.pitch).toString() == "Bb4");
+    REQUIRE(flat.cents == Approx(-30).margin(0.002));
+
+    // Frequencies right around the halfway points must round the same way as an exact search
+    std::vector<float> frequencies;
+    for (int midi = 1; midi < 128; ++midi)
+    {
+        double halfway = 440 * std::pow(2.0, (midi - 69.5) / 12);
+        frequencies.push_back(std::nextafter(static_cast<float>(halfway), 0.0f));
+        frequencies.push_back(std::nextafter(static_cast<float>(halfway), 1e9f));
+    }
+    std::vector<mt::PitchEstimate> estimates(frequencies.size());
+    mt::nearestPitches(frequencies.data(), frequencies.size(), estimates.data());
+    for (std::size_t i = 0; i < frequencies.size(); ++i)
+    {
+        int best = 0;
+        for (unsigned short midi = 1; midi < 128; ++midi)
+        {
+            if (std::fabs(std::log2(frequencies[i] / mt::Pitch(midi).getFrequency())) <
+                std::fabs(std::log2(frequencies[i] / mt::Pitch(best).getFrequency())))
+            {
+                best = midi;
+            }
+        }
+        REQUIRE(estimates[i].midi_value == best);
+        REQUIRE(estimates[i].pitch.getMidiValue() == best);
+    }
+
+    REQUIRE(std::isnan(mt::nearestPitch(-1.0).cents));
+    REQUIRE(mt::nearestPitch(1e6).midi_value == 127);
+}
+
+TEST_CASE("Pitch values can be used in constant expressions", "[Pitch]")
+{
+    constexpr mt::Pitch a4(mt::Key(mt::Key::Type::A), mt::Accidental(), 4);
+    static_assert(a4.getMidiValue() == 69, "");
+    static_assert(a4.getFrequency() == 440.0, "");
+    static_assert(a4.getKey().getType() == mt::Key::Type::A, "");
+    static_assert(mt::Pitch().getMidiValue() == 60, "Default Pitch is C4");
+    static_assert(mt::Pitch(mt::PackedPitch(a4)).getOctave() == 4, "");
+    static_assert(mt::Pitch(mt::PackedPitch::fromMidi(61, false)).getAccidental().getType() ==
+                      mt::Accidental::Type::flat,
+                  "");
+    static_assert(noexcept(a4.getFrequency()) && noexcept(mt::Intervals::P5.getSemitones()), "");
+
+    // Pitches outside the MIDI range still get a frequency
+    const mt::Pitch high(mt::Key(mt::Key::Type::A), mt::Accidental(), 10);
+    REQUIRE(high.getFrequency() == Approx(440.0 * 64));
+    const mt::Pitch low(mt::Key(mt::Key::Type::C), mt::Accidental(mt::Accidental::Type::flat), -1);
+    REQUIRE(low.getFrequency() == Approx(mt::Pitch("B-1").getFrequency() / 2));
+    REQUIRE(high.toString() == "A10");
+}
+
+TEST_CASE("Pitches and intervals can be compared and hashed", "[Pitch][Interval]")
+{
+    REQUIRE(mt::Pitch("C#4") == mt::Pitch(61));
+    REQUIRE(mt::Pitch("C#4") != mt::Pitch("Db4"));
+    REQUIRE(mt::Pitch("B#3") < mt::Pitch("C4"));
+    REQUIRE(mt::Pitch("C4") < mt::Pitch("Dbb4"));
+    REQUIRE(!(mt::Pitch("Cb4") < mt::Pitch("B3")));
+    REQUIRE(mt::Pitch("B3") < mt::Pitch("Cb4"));
+    REQUIRE(mt::Pitch("G9") < mt::Pitch(mt::Key(mt::Key::Type::A), mt::Accidental(), 10));
+    REQUIRE(!(mt::Pitch("E4") < mt::Pitch("E4")));
+    static_assert(mt::PackedPitch(mt::Key::Type::A) < mt::PackedPitch(mt::Key::Type::B), "");
+
+    // Every MIDI spelling sorts the same packed or not, and hashes without collisions
+    std::vector<mt::Pitch> pitches;
+    std::vector<mt::PackedPitch> packed;
+    for (unsigned short midi = 0; midi < 128; ++midi)
+    {
+        for (bool use_sharps : {true, false})
+        {
+            pitches.push_back(mt::Pitch(midi, use_sharps));
+            packed.push_back(mt::PackedPitch::fromMidi(static_cast<std::uint8_t>(midi), use_sharps));
+        }
+    }
+    std::reverse(pitches.begin(), pitches.end());
+    std::reverse(packed.begin(), packed.end());
+    std::sort(pitches.begin(), pitches.end());
+    std::sort(packed.begin(), packed.end());
+    for (std::size_t i = 0; i < pitches.size(); ++i)
+    {
+        REQUIRE(mt::PackedPitch(pitches[i]) == packed[i]);
+        if (i > 0)
+        {
+            REQUIRE(pitches[i - 1].getMidiValue() <= pitches[i].getMidiValue());
+        }
+    }
+    std::unordered_set<mt::Pitch> unique_pitches(pitches.begin(), pitches.end());
+    std::unordered_set<mt::PackedPitch> unique_packed(packed.begin(), packed.end());
+    REQUIRE(unique_pitches.size() == 128 + 5 * 10 + 3);
+    REQUIRE(unique_packed.size() == unique_pitches.size());
+
+    using Q = mt::Interval::Quality;
+    REQUIRE(mt::Interval(Q::minor, 3) == mt::Intervals::m3);
+    REQUIRE(mt::Interval(Q::augmented, 2) != mt::Intervals::m3);
+    REQUIRE(mt::Intervals::A4 < mt::Interval(Q::diminished, 5));
+    REQUIRE(mt::Intervals::P5 < mt::Interval(Q::minor, 9));
+    std::unordered_set<mt::Interval> intervals;
+    std::set<mt::Interval> ordered;
+    for (int q = 0; q < 7; ++q)
+    {
+        for (unsigned short d = 1; d <= 15; ++d)
+        {
+            try
+            {
+                mt::Interval interval(static_cast<Q>(q), d);
+                intervals.insert(interval);
+                ordered.insert(interval);
+            }
+            catch (mt::InvalidIntervalException &)
+            {
+            }
+        }
+    }
+    REQUIRE(intervals.size() == ordered.size());
+    REQUIRE(ordered.begin()->getSemitones() == 0);
+}
+
 TEST_CASE("Intervals can be made and used", "[Interval]")
 {
     mt::Interval i(5);
@@ -85,6 +450,476 @@ TEST_CASE("Intervals can be compound!", "[Interval]")
     REQUIRE(i.toString() == "M9");
 }
 
+TEST_CASE("Scales and chords can be expanded from a root", "[Scale][Chord]")
+{
+    using namespace mt::Intervals;
+    mt::Scale major({P1, M2, M3, P4, P5, M6, M7, P8});
+    mt::Chord minor7({P1, m3, P5, m7});
+
+    REQUIRE(major.getIntervals().size() == 8);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        std::vector<std::string> names;
+        for (auto p : major.getPitchesFromRoot(mt::Pitch("D4")))
+        {
+            names.push_back(p.toString());
+        }
+        REQUIRE(names == std::vector<std::string>{"D4", "E4", "F#4", "G4", "A4", "B4", "C#5", "D5"});
+
+        auto chord = minor7.getPitchesFromRoot(mt::Pitch("A3"));
+        REQUIRE(chord.size() == 4);
+        REQUIRE(chord[1].toString() == "C4");
+        REQUIRE(chord[3].toString() == "G4");
+    }
+
+    // Same intervals over a different root, and a different chord over the same root
+    REQUIRE(minor7.getPitchesFromRoot(mt::Pitch("C4"))[1].toString() == "D#4");
+    REQUIRE(mt::Chord({P1, M3, P5}).getPitchesFromRoot(mt::Pitch("C4"))[1].toString() == "E4");
+    REQUIRE_THROWS_AS(major.getPitchesFromRoot(mt::Pitch("C9")), mt::PitchParsingException);
+}
+
+TEST_CASE("Scales and chords store their intervals inline", "[Scale][Chord]")
+{
+    using namespace mt::Intervals;
+    static_assert(std::is_trivially_copyable<mt::Chord>::value, "Copying a Chord never allocates");
+
+    mt::Chord seventh({P1, M3, P5, m7});
+    mt::IntervalSpan span = seventh.getIntervalSpan();
+    REQUIRE(span.size() == 4);
+    REQUIRE(span[3].getSemitones() == 10);
+    std::vector<int> semitones;
+    for (mt::Interval interval : span)
+    {
+        semitones.push_back(interval.getSemitones());
+    }
+    REQUIRE(semitones == std::vector<int>{0, 4, 7, 10});
+
+    std::vector<mt::Interval> intervals = {P1, M2, M3, P4, P5, M6, M7};
+    mt::Scale from_vector(intervals);
+    mt::Scale from_span(from_vector.getIntervalSpan());
+    mt::Scale copy = from_span;
+    REQUIRE(copy.getIntervals().size() == 7);
+    REQUIRE(copy.getIntervalSpan()[6].getQuality() == mt::Interval::Quality::major);
+    REQUIRE(copy.getIntervalSpan().data() != from_span.getIntervalSpan().data());
+    REQUIRE(mt::Scale(std::vector<mt::Interval>()).getIntervalSpan().empty());
+
+    std::vector<mt::Interval> too_many(mt::IntervalList::capacity + 1, P1);
+    REQUIRE_THROWS_AS(mt::Chord(too_many), mt::InvalidIntervalException);
+    REQUIRE_NOTHROW(mt::Chord(mt::IntervalSpan(too_many.data(), mt::IntervalList::capacity)));
+}
+
+TEST_CASE("Pitch collections can be allocated from a memory resource", "[Scale][Chord]")
+{
+    using namespace mt::Intervals;
+    mt::Scale major({P1, M2, M3, P4, P5, M6, M7});
+    mt::Chord triad({P1, M3, P5});
+
+    // Every result below has to fit the stack buffer, as the arena can't fall back on the heap
+    unsigned char buffer[4096];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+
+    std::pmr::vector<mt::Pitch> scale_pitches = major.getPitchesFromRoot(mt::Pitch("D4"), &arena);
+    REQUIRE(scale_pitches.get_allocator().resource() == &arena);
+    auto expected = major.getPitchesFromRoot(mt::Pitch("D4"));
+    REQUIRE(scale_pitches.size() == expected.size());
+    for (std::size_t i = 0; i < expected.size(); ++i)
+    {
+        REQUIRE(scale_pitches[i].toString() == expected[i].toString());
+    }
+
+    std::pmr::vector<mt::Pitch> chord_pitches = triad.getPitchesFromRoot(mt::Pitch("A3"), &arena);
+    REQUIRE(chord_pitches.size() == 3);
+    REQUIRE(chord_pitches[1].toString() == "C#4");
+    REQUIRE(triad.getIntervals(&arena).size() == 3);
+    REQUIRE(major.getIntervals(&arena)[6].getSemitones() == 11);
+
+    std::pmr::vector<mt::ScaleMatch> found =
+        mt::findScales(mt::PitchClassSet().with(0).with(4).with(7).with(11), &arena);
+    REQUIRE(found.get_allocator().resource() == &arena);
+    REQUIRE(found.size() == mt::findScales(mt::PitchClassSet().with(0).with(4).with(7).with(11)).size());
+
+    unsigned char tiny[8];
+    std::pmr::monotonic_buffer_resource full(tiny, sizeof(tiny), std::pmr::null_memory_resource());
+    REQUIRE_THROWS_AS(major.getPitchesFromRoot(mt::Pitch("D4"), &full), std::bad_alloc);
+}
+
+TEST_CASE("Scales and chords can be compared and hashed", "[Scale][Chord]")
+{
+    using namespace mt::Intervals;
+    mt::Chord major({P1, M3, P5});
+    mt::Chord minor({P1, m3, P5});
+    REQUIRE(major == mt::Chords::major::toChord());
+    REQUIRE(major != minor);
+    REQUIRE(minor < major);
+    REQUIRE(major < mt::Chord({P1, M3, P5, m7}));
+    REQUIRE(mt::Scale({P1, M2}) != mt::Scale({P1, M2, M3}));
+
+    std::unordered_map<mt::Chord, std::string> names;
+    names[major] = "major";
+    names[minor] = "minor";
+    names[mt::Chord({P1, M3, P5})] = "major triad";
+    REQUIRE(names.size() == 2);
+    REQUIRE(names[major] == "major triad");
+    REQUIRE(std::hash<mt::Chord>()(major) != std::hash<mt::Chord>()(minor));
+
+    std::unordered_set<mt::Scale> modes;
+    for (const mt::CatalogScale &entry : mt::scaleCatalog())
+    {
+        modes.insert(entry.scale);
+    }
+    REQUIRE(modes.size() == mt::scaleCatalog().size());
+    std::unordered_set<mt::PitchClassSet> sets = {mt::PitchClassSet(major), mt::PitchClassSet(minor),
+                                                  mt::Chords::major::pitch_classes};
+    REQUIRE(sets.size() == 2);
+}
+
+TEST_CASE("Scales and chords can be turned into pitch class sets", "[PitchClassSet]")
+{
+    using namespace mt::Intervals;
+    mt::PitchClassSet major(mt::Scale({P1, M2, M3, P4, P5, M6, M7, P8}));
+    REQUIRE(major.getMask() == 0xAB5);
+    REQUIRE(major.size() == 7);
+    REQUIRE(major.contains(4));
+    REQUIRE(!major.contains(3));
+
+    mt::PitchClassSet triad(mt::Chord({P1, M3, P5}));
+    REQUIRE(triad.isSubsetOf(major));
+    REQUIRE(triad.transpose(7).isSubsetOf(major));
+    REQUIRE(!triad.transpose(1).isSubsetOf(major));
+    REQUIRE(triad.transpose(-5) == triad.transpose(7));
+    REQUIRE((triad | triad.transpose(7)) == triad.with(7).with(11).with(2));
+    REQUIRE((major & ~triad).size() == 4);
+
+    static_assert(mt::PitchClassSet(0x091).transpose(12).getMask() == 0x091, "constexpr rotate");
+
+    auto intervals = triad.with(10).toChord().getIntervals();
+    REQUIRE(intervals.size() == 4);
+    REQUIRE(intervals[3].toString() == "m7");
+    REQUIRE(mt::PitchClassSet(major.toScale()) == major);
+}
+
+TEST_CASE("Chords can be recognized from sounding pitches", "[Chord]")
+{
+    auto names = [](std::vector<std::string> notes) {
+        std::vector<mt::Pitch> pitches;
+        for (auto &n : notes)
+        {
+            pitches.emplace_back(n);
+        }
+        return mt::recognizeChord(pitches);
+    };
+
+    auto c = names({"C4", "E4", "G4"});
+    REQUIRE(c.found);
+    REQUIRE(c.exact);
+    REQUIRE(c.root == 0);
+    REQUIRE(std::string(c.name) == "");
+    REQUIRE(c.inversion == 0);
+
+    auto first_inversion = names({"G4", "C5", "E3"});
+    REQUIRE(first_inversion.root == 0);
+    REQUIRE(first_inversion.inversion == 1);
+
+    auto am7 = names({"A2", "C4", "E4", "G4"});
+    REQUIRE(am7.root == 9);
+    REQUIRE(std::string(am7.name) == "m7");
+    auto c6 = names({"C3", "A3", "E4", "G4"});
+    REQUIRE(c6.root == 0);
+    REQUIRE(std::string(c6.name) == "6");
+
+    auto dim7 = names({"B3", "D4", "F4", "Ab4"});
+    REQUIRE(dim7.root == 11);
+    REQUIRE(std::string(dim7.name) == "dim7");
+
+    auto nine = names({"C3", "E3", "G3", "Bb3", "D4"});
+    REQUIRE(std::string(nine.name) == "9");
+    REQUIRE(nine.getChord().getIntervals().size() == 5);
+
+    auto extra = names({"C4", "E4", "F#4", "G4"});
+    REQUIRE(extra.found);
+    REQUIRE(!extra.exact);
+    REQUIRE(extra.root == 0);
+    REQUIRE(std::string(extra.name) == "");
+
+    REQUIRE(!names({"C4"}).found);
+    REQUIRE(!names({"C4", "C#4"}).found);
+
+    mt::PackedPitch packed[] = {mt::PackedPitch::fromMidi(62), mt::PackedPitch::fromMidi(65),
+                                mt::PackedPitch::fromMidi(69)};
+    auto dm = mt::recognizeChord(packed, 3);
+    REQUIRE(dm.root == 2);
+    REQUIRE(std::string(dm.name) == "m");
+
+    // Cb-1 is below MIDI 0, it still counts as the bass and as pitch class B
+    auto b_major = names({"Eb0", "Gb0", "Cb-1"});
+    REQUIRE(b_major.found);
+    REQUIRE(b_major.root == 11);
+    REQUIRE(b_major.inversion == 0);
+    mt::PackedPitch low[] = {mt::PackedPitch(mt::Pitch("Gb0")), mt::PackedPitch(mt::Pitch("Cb-1")),
+                             mt::PackedPitch(mt::Pitch("Eb0"))};
+    REQUIRE(mt::recognizeChord(low, 3).root == 11);
+    REQUIRE(mt::recognizeChord(low, 3).inversion == 0);
+}
+
+TEST_CASE("Scales containing a set of pitches can be found", "[Scale]")
+{
+    auto &catalog = mt::scaleCatalog();
+    REQUIRE(catalog.size() == 31);
+    REQUIRE(std::string(catalog[1].name) == "Dorian");
+    REQUIRE(catalog[1].pitch_classes.getMask() == 0x6AD);
+
+    // Modes keep the degrees of their parent scale, so Locrian has a diminished 5th
+    auto spell = [](const mt::CatalogScale &entry) {
+        std::string spelled;
+        for (mt::Interval interval : entry.scale.getIntervalSpan())
+        {
+            spelled += interval.getSpelledPitchFromRoot(mt::Pitch("C4")).toString() + " ";
+        }
+        return spelled;
+    };
+    REQUIRE(std::string(catalog[6].name) == "Locrian");
+    REQUIRE(spell(catalog[6]) == "C4 Db4 Eb4 F4 Gb4 Ab4 Bb4 ");
+    REQUIRE(std::string(catalog[13].name) == "Altered");
+    REQUIRE(spell(catalog[13]) == "C4 Db4 Eb4 Fb4 Gb4 Ab4 Bb4 ");
+
+    std::vector<mt::Pitch> pitches = {mt::Pitch("C4"), mt::Pitch("D4"), mt::Pitch("E4"), mt::Pitch("F#4"),
+                                      mt::Pitch("G4"), mt::Pitch("A4")};
+    auto matches = mt::findScales(pitches);
+    auto has = [&](std::string name, unsigned root) {
+        for (auto &m : matches)
+        {
+            if (m.scale->name == name && m.root == root)
+            {
+                return true;
+            }
+        }
+        return false;
+    };
+    REQUIRE(has("Ionian", 7));
+    REQUIRE(has("Lydian", 0));
+    REQUIRE(has("Dorian", 9));
+    REQUIRE(has("Chromatic", 5));
+    REQUIRE(!has("Ionian", 0));
+
+    // Every match really contains the pitches, and nothing containing them is missed
+    std::size_t expected = 0;
+    for (auto entry : catalog)
+    {
+        for (unsigned short root = 0; root < 12; ++root)
+        {
+            std::set<int> scale_pitch_classes;
+            for (auto p : entry.scale.getPitchesFromRoot(mt::Pitch(static_cast<unsigned short>(60 + root))))
+            {
+                scale_pitch_classes.insert(p.getMidiValue() % 12);
+            }
+            bool contains = true;
+            for (auto p : pitches)
+            {
+                contains = contains && scale_pitch_classes.count(p.getMidiValue() % 12);
+            }
+            expected += contains;
+        }
+    }
+    REQUIRE(matches.size() == expected);
+    REQUIRE(mt::findScales(mt::PitchClassSet()).size() == catalog.size() * 12);
+}
+
+TEST_CASE("Intervals of every quality have semitones and round-trip", "[Interval]")
+{
+    using Q = mt::Interval::Quality;
+    REQUIRE(mt::Interval(Q::diminished, 5).getSemitones() == 6);
+    REQUIRE(mt::Interval(Q::diminished, 7).getSemitones() == 9);
+    REQUIRE(mt::Interval(Q::augmented, 5).getSemitones() == 8);
+    REQUIRE(mt::Interval(Q::augmented, 2).getSemitones() == 3);
+    REQUIRE(mt::Interval(Q::doubly_augmented, 4).getSemitones() == 7);
+    REQUIRE(mt::Interval(Q::doubly_diminished, 10).getSemitones() == 13);
+    REQUIRE(mt::Interval(Q::diminished, 8).getSemitones() == 11);
+    REQUIRE(mt::Interval(Q::doubly_augmented, 4).toString() == "AA4");
+    REQUIRE(mt::Interval(Q::doubly_diminished, 7).toString() == "dd7");
+
+    REQUIRE_THROWS_AS(mt::Interval(Q::major, 4), mt::InvalidIntervalException);
+    REQUIRE_THROWS_AS(mt::Interval(Q::perfect, 3), mt::InvalidIntervalException);
+    REQUIRE_THROWS_AS(mt::Interval(Q::diminished, 1), mt::InvalidIntervalException);
+    REQUIRE_THROWS_AS(mt::Interval(Q::doubly_diminished, 2), mt::InvalidIntervalException);
+    REQUIRE_THROWS_AS(mt::Interval(7, 3), mt::InvalidIntervalException);
+    REQUIRE_THROWS_AS(mt::Interval(0, 0), mt::InvalidIntervalException);
+
+    int valid = 0;
+    for (int q = 0; q < 7; ++q)
+    {
+        for (unsigned short degree = 1; degree <= 22; ++degree)
+        {
+            try
+            {
+                mt::Interval i(static_cast<Q>(q), degree);
+                mt::Interval back(i.getSemitones(), degree);
+                REQUIRE(back.getQuality() == i.getQuality());
+                REQUIRE(back.getDegree() == degree);
+                ++valid;
+            }
+            catch (mt::InvalidIntervalException &)
+            {
+            }
+        }
+    }
+    REQUIRE(valid == 10 * 5 + 12 * 6 - 3);
+
+    for (unsigned short semitones = 0; semitones < 36; ++semitones)
+    {
+        REQUIRE(mt::Interval(semitones).getSemitones() == semitones);
+    }
+}
+
+TEST_CASE("Pitches can be transposed keeping their spelling", "[Interval]")
+{
+    using Q = mt::Interval::Quality;
+    REQUIRE(mt::Intervals::m3.getSpelledPitchFromRoot(mt::Pitch("Bb3")).toString() == "Db4");
+    REQUIRE(mt::Intervals::m3.getPitchFromRoot(mt::Pitch("Bb3")).toString() == "C#4");
+    REQUIRE(mt::Intervals::A4.getSpelledPitchFromRoot(mt::Pitch("C4")).toString() == "F#4");
+    REQUIRE(mt::Intervals::M3.getSpelledPitchFromRoot(mt::Pitch("E#4")).toString() == "G##4");
+    REQUIRE(mt::Interval(Q::diminished, 7).getSpelledPitchFromRoot(mt::Pitch("C#4")).toString() == "Bb4");
+    REQUIRE_THROWS_AS(mt::Intervals::M3.getSpelledPitchFromRoot(mt::Pitch("B##4")), mt::PitchParsingException);
+
+    mt::PackedPitch p(mt::Key::Type::C, mt::Accidental::Type::natural, 4);
+    REQUIRE(mt::transpose(p, mt::Intervals::m2, false));
+    REQUIRE(mt::Pitch(p).toString() == "B3");
+    REQUIRE(mt::transpose(p, mt::Interval(Q::perfect, 12), false));
+    REQUIRE(mt::Pitch(p).toString() == "E2");
+    mt::PackedPitch low = mt::PackedPitch::fromMidi(0);
+    REQUIRE(!mt::transpose(low, mt::Intervals::M2, false));
+    REQUIRE(low.getMidiValue() == 0);
+
+    mt::PackedPitch chord[] = {mt::PackedPitch(mt::Key::Type::C), mt::PackedPitch(mt::Key::Type::E),
+                               mt::PackedPitch(mt::Key::Type::G), mt::PackedPitch(mt::Key::Type::B)};
+    REQUIRE(mt::transpose(chord, 4, mt::Intervals::m6) == 4);
+    REQUIRE(mt::Pitch(chord[0]).toString() == "Ab4");
+    REQUIRE(mt::Pitch(chord[1]).toString() == "C5");
+    REQUIRE(mt::Pitch(chord[2]).toString() == "Eb5");
+    REQUIRE(mt::Pitch(chord[3]).toString() == "G5");
+
+    // Every spelled result sounds the same as the semitone based one
+    for (unsigned short midi = 24; midi < 100; ++midi)
+    {
+        for (unsigned short semitones = 0; semitones < 24; ++semitones)
+        {
+            mt::Interval interval(semitones);
+            mt::PackedPitch flat = mt::PackedPitch::fromMidi(static_cast<std::uint8_t>(midi), false);
+            REQUIRE(mt::transpose(flat, interval));
+            REQUIRE(flat.getMidiValue() == midi + semitones);
+            REQUIRE(mt::transpose(flat, interval, false));
+            REQUIRE(flat.getMidiValue() == midi);
+        }
+    }
+}
+
+TEST_CASE("Intervals can be found between pitches", "[Interval]")
+{
+    using Q = mt::Interval::Quality;
+    mt::Interval i = mt::intervalBetween(mt::Pitch("C4"), mt::Pitch("Eb4"));
+    REQUIRE(i.getQuality() == Q::minor);
+    REQUIRE(i.getDegree() == 3);
+    i = mt::intervalBetween(mt::Pitch("C4"), mt::Pitch("D#4"));
+    REQUIRE(i.getQuality() == Q::augmented);
+    REQUIRE(i.getDegree() == 2);
+    i = mt::intervalBetween(mt::Pitch("C4"), mt::Pitch("D#4"), false);
+    REQUIRE(i.getQuality() == Q::minor);
+    REQUIRE(i.getDegree() == 3);
+    i = mt::intervalBetween(mt::Pitch("G4"), mt::Pitch("C4"));
+    REQUIRE(i.getQuality() == Q::perfect);
+    REQUIRE(i.getDegree() == 5);
+    i = mt::intervalBetween(mt::Pitch("C#4"), mt::Pitch("C4"));
+    REQUIRE(i.getQuality() == Q::augmented);
+    REQUIRE(i.getDegree() == 1);
+    i = mt::intervalBetween(mt::Pitch("C3"), mt::Pitch("Db5"));
+    REQUIRE(i.getQuality() == Q::minor);
+    REQUIRE(i.getDegree() == 16);
+    REQUIRE_THROWS_AS(mt::intervalBetween(mt::Pitch("B#3"), mt::Pitch("Cb4")), mt::InvalidIntervalException);
+
+    // Every spelled transposition is undone by intervalBetween
+    for (unsigned short midi = 24; midi < 100; ++midi)
+    {
+        for (unsigned short semitones = 0; semitones < 24; ++semitones)
+        {
+            mt::Interval interval(semitones);
+            mt::PackedPitch root = mt::PackedPitch::fromMidi(static_cast<std::uint8_t>(midi), midi % 2 == 0);
+            mt::PackedPitch top = root;
+            REQUIRE(mt::transpose(top, interval));
+            mt::Interval between = mt::intervalBetween(top, root);
+            REQUIRE(between.getQuality() == interval.getQuality());
+            REQUIRE(between.getDegree() == interval.getDegree());
+        }
+    }
+
+    std::vector<mt::PackedPitch> melody;
+    for (auto name : {"C4", "E4", "Eb4", "G3", "G#3", "C5"})
+    {
+        melody.push_back(mt::PackedPitch(mt::Pitch(name)));
+    }
+    std::int16_t semitones[5];
+    std::int16_t steps[5];
+    mt::melodicIntervals(melody.data(), melody.size(), semitones, steps);
+    std::vector<int> expected_semitones = {4, -1, -8, 1, 16};
+    std::vector<int> expected_steps = {2, 0, -5, 0, 10};
+    for (std::size_t n = 0; n < 5; ++n)
+    {
+        REQUIRE(semitones[n] == expected_semitones[n]);
+        REQUIRE(steps[n] == expected_steps[n]);
+        REQUIRE(semitones[n] == melody[n + 1].getMidiValue() - melody[n].getMidiValue());
+    }
+    mt::melodicIntervals(melody.data(), 1, semitones, nullptr);
+
+    std::vector<mt::PackedPitch> long_melody;
+    for (unsigned short n = 0; n < 45; ++n)
+    {
+        long_melody.push_back(mt::PackedPitch::fromMidi(static_cast<std::uint8_t>(40 + n * 7 % 31), n % 3 == 0));
+    }
+    std::vector<std::int16_t> long_semitones(long_melody.size() - 1);
+    mt::melodicIntervals(long_melody.data(), long_melody.size(), long_semitones.data(), nullptr);
+    for (std::size_t n = 0; n + 1 < long_melody.size(); ++n)
+    {
+        REQUIRE(long_semitones[n] == long_melody[n + 1].getMidiValue() - long_melody[n].getMidiValue());
+    }
+}
+
+TEST_CASE("Scales and chords can be evaluated at compile time", "[Scale][Chord]")
+{
+    static_assert(mt::Intervals::m7.getSemitones() == 10, "Interval constants are constexpr");
+    static_assert(mt::Interval(6).getQuality() == mt::Interval::Quality::augmented, "Interval(semitones) is constexpr");
+    static_assert(mt::Chords::major::size == 3, "");
+    static_assert(mt::Chords::major::pitch_classes == mt::PitchClassSet(0x091), "");
+    static_assert(mt::Chords::diminished7::semitones[3] == 9, "");
+    static_assert(mt::Scales::major::pitchClassesFromRoot(7).contains(6), "G major has F#");
+    static_assert(!mt::Scales::major::pitchClassesFromRoot(7).contains(5), "G major has no F");
+
+    constexpr mt::PackedPitch c4(mt::Key::Type::C);
+    constexpr auto g7 = mt::Chords::dominant7::getPitchesFromRoot(mt::PackedPitch::fromMidi(67));
+    static_assert(g7[3].getMidiValue() == 77, "");
+    static_assert(mt::Chords::minor::getPitchesFromRoot(c4, false)[1].getAccidentalType() ==
+                      mt::Accidental::Type::flat,
+                  "");
+
+    // Same answers as the runtime classes
+    auto check_chord = [](auto static_chord, mt::Chord chord) {
+        using Static = decltype(static_chord);
+        REQUIRE(Static::pitch_classes == mt::PitchClassSet(chord));
+        auto pitches = chord.getPitchesFromRoot(mt::Pitch("D4"));
+        auto static_pitches = Static::getPitchesFromRoot(mt::PackedPitch(mt::Pitch("D4")));
+        REQUIRE(pitches.size() == static_pitches.size());
+        for (std::size_t i = 0; i < pitches.size(); ++i)
+        {
+            REQUIRE(pitches[i].toString() == mt::Pitch(static_pitches[i]).toString());
+        }
+        REQUIRE(Static::toChord().getIntervals().size() == chord.getIntervals().size());
+    };
+    check_chord(mt::Chords::major(), mt::Chord({mt::Intervals::P1, mt::Intervals::M3, mt::Intervals::P5}));
+    check_chord(mt::Chords::half_diminished7(),
+                mt::Chord({mt::Intervals::P1, mt::Intervals::m3, mt::Intervals::d5, mt::Intervals::m7}));
+    REQUIRE(mt::Scales::harmonic_minor::pitch_classes == mt::PitchClassSet(mt::Scales::harmonic_minor::toScale()));
+    REQUIRE(mt::recognizeChord(mt::Chords::minor7::pitchClassesFromRoot(9), 9).name == std::string("m7"));
+
+    REQUIRE_THROWS_AS(mt::Scales::major::getPitchesFromRoot(mt::PackedPitch::fromMidi(120)), mt::PitchParsingException);
+}
+
 TEST_CASE("Interval convencience constants can be used", "[Interval]")
 {
     REQUIRE(mt::Intervals::M2.getSemitones() == 2);
@@ -93,4 +928,446 @@ TEST_CASE("Interval convencience constants can be used", "[Interval]")
     REQUIRE(mt::Intervals::P5.getSemitones() == 7);
     REQUIRE(mt::Intervals::M7.getSemitones() == 11);
     REQUIRE(mt::Intervals::m2.getPitchFromRoot(mt::Pitch()).toString() == "C#4");
-}
\ No newline at end of file
+}
+
+namespace
+{
+//! Builds a Standard MIDI File from the event bytes of each track
+std::vector<std::uint8_t> makeMidiFile(std::uint16_t format, std::uint16_t division,
+                                       std::vector<std::vector<std::uint8_t>> tracks)
+{
+    std::vector<std::uint8_t> file = {'M', 'T', 'h', 'd', 0, 0, 0, 6};
+    for (std::uint16_t value : {format, static_cast<std::uint16_t>(tracks.size()), division})
+    {
+        file.push_back(static_cast<std::uint8_t>(value >> 8));
+        file.push_back(static_cast<std::uint8_t>(value));
+    }
+    for (auto &track : tracks)
+    {
+        file.insert(file.end(), {'M', 'T', 'r', 'k'});
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            file.push_back(static_cast<std::uint8_t>(track.size() >> shift));
+        }
+        file.insert(file.end(), track.begin(), track.end());
+    }
+    return file;
+}
+} // namespace
+
+TEST_CASE("Standard MIDI files can be decoded into note columns", "[Midi]")
+{
+    // Tempo meta, C4 with running status and a velocity 0 note off, a sysex, then E4 after a 2 byte delta
+    auto bytes = makeMidiFile(0, 480,
+                              {{0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20, 0x00, 0x90, 60, 100, 0x83, 0x60, 60, 0,
+                                0x00, 0xF0, 0x02, 0x7E, 0xF7, 0x81, 0x00, 0x91, 64, 90, 0x10, 0x81, 64, 0, 0x00,
+                                0xFF, 0x2F, 0x00}});
+    mt::MidiFile file = mt::parseMidi(bytes.data(), bytes.size());
+    REQUIRE(file.format == 0);
+    REQUIRE(file.track_count == 1);
+    REQUIRE(file.division == 480);
+    REQUIRE(file.notes.size() == 2);
+    REQUIRE(file.notes.ticks == std::vector<std::uint32_t>{0, 608});
+    REQUIRE(file.notes.durations == std::vector<std::uint32_t>{480, 16});
+    REQUIRE(file.notes.channels == std::vector<std::uint8_t>{0, 1});
+    REQUIRE(file.notes.notes == std::vector<std::uint8_t>{60, 64});
+    REQUIRE(file.notes.velocities == std::vector<std::uint8_t>{100, 90});
+    REQUIRE(mt::Pitch(file.notes.getPitch(1)).toString() == "E4");
+
+    // Format 1: overlapping C4s close first in first out, unknown chunks are skipped and a
+    // note left sounding lasts until the end of its track
+    auto two_tracks = makeMidiFile(1, 96,
+                                   {{0x00, 0x90, 60, 10, 0x0A, 60, 20, 0x0A, 0x80, 60, 0, 0x0A, 60, 0},
+                                    {0x05, 0x92, 67, 50, 0x20, 0xFF, 0x2F, 0x00}});
+    std::vector<std::uint8_t> unknown = {'X', 'Y', 'Z', 'W', 0, 0, 0, 2, 1, 2};
+    two_tracks.insert(two_tracks.begin() + 14, unknown.begin(), unknown.end());
+    mt::parseMidi(two_tracks.data(), two_tracks.size(), file);
+    REQUIRE(file.format == 1);
+    REQUIRE(file.notes.size() == 3);
+    REQUIRE(file.notes.ticks == std::vector<std::uint32_t>{0, 10, 5});
+    REQUIRE(file.notes.durations == std::vector<std::uint32_t>{20, 20, 32});
+    REQUIRE(file.notes.velocities == std::vector<std::uint8_t>{10, 20, 50});
+    REQUIRE(file.notes.tracks == std::vector<std::uint16_t>{0, 0, 1});
+    REQUIRE(file.notes.channels[2] == 2);
+
+    std::vector<std::uint8_t> no_header = {'M', 'T', 'r', 'k', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    REQUIRE_THROWS_AS(mt::parseMidi(no_header.data(), no_header.size()), mt::MidiFileException);
+    auto format_2 = makeMidiFile(2, 96, {});
+    REQUIRE_THROWS_AS(mt::parseMidi(format_2.data(), format_2.size()), mt::MidiFileException);
+    auto no_status = makeMidiFile(0, 96, {{0x00, 60, 100}});
+    REQUIRE_THROWS_AS(mt::parseMidi(no_status.data(), no_status.size()), mt::MidiFileException);
+    auto truncated = makeMidiFile(0, 96, {{0x00, 0x90, 60}});
+    REQUIRE_THROWS_AS(mt::parseMidi(truncated.data(), truncated.size()), mt::MidiFileException);
+    auto long_delta = makeMidiFile(0, 96, {{0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0x90, 60, 100}});
+    REQUIRE_THROWS_AS(mt::parseMidi(long_delta.data(), long_delta.size()), mt::MidiFileException);
+    bytes.pop_back();
+    REQUIRE_THROWS_AS(mt::parseMidi(bytes.data(), bytes.size()), mt::MidiFileException);
+}
+
+TEST_CASE("Standard MIDI files can be memory-mapped and read", "[Midi]")
+{
+    auto bytes = makeMidiFile(0, 480, {{0x00, 0x90, 69, 64, 0x60, 0x80, 69, 0}});
+    const char *path = "mt_test_read.mid";
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+    mt::MidiFile file = mt::readMidiFile(path);
+    std::remove(path);
+    REQUIRE(file.notes.size() == 1);
+    REQUIRE(file.notes.durations[0] == 0x60);
+    REQUIRE(mt::Pitch(file.notes.getPitch(0)).getFrequency() == 440.0);
+
+    REQUIRE_THROWS_AS(mt::readMidiFile("does/not/exist.mid"), std::system_error);
+}
+
+TEST_CASE("Notes can be encoded into Standard MIDI files", "[Midi]")
+{
+    // A C major scale, one note per quarter, written with running status
+    mt::MidiNotes scale;
+    std::uint32_t tick = 0;
+    for (mt::Pitch p : mt::Scales::major::toScale().getPitchesFromRoot(mt::Pitch("C4")))
+    {
+        scale.append(tick, 480, mt::PackedPitch(p), 100);
+        tick += 480;
+    }
+    mt::MidiWriter writer;
+    const std::vector<std::uint8_t> &bytes = writer.encode(scale, 480);
+    // Header, track chunk header, end of track, one status byte, then 3 or 4 bytes per on and per off
+    REQUIRE(bytes.size() == 14 + 8 + 4 + 1 + 7 * 3 + 7 * 4);
+    REQUIRE(bytes[9] == 0); // format 0
+    mt::MidiFile file = mt::parseMidi(bytes.data(), bytes.size());
+    REQUIRE(file.division == 480);
+    REQUIRE(file.notes.notes == scale.notes);
+    REQUIRE(file.notes.ticks == scale.ticks);
+    REQUIRE(file.notes.durations == scale.durations);
+    REQUIRE(file.notes.velocities == scale.velocities);
+
+    // Out of order notes over several tracks and channels, repeated and zero length notes
+    mt::MidiNotes mixed;
+    mixed.append(960, 240, 67, 90, 1, 2);
+    mixed.append(0, 480, 60, 80, 0, 0);
+    mixed.append(480, 480, 60, 81, 0, 0);
+    mixed.append(480, 0, 62, 82, 9, 0);
+    mixed.append(200000000, 10, 64, 83, 0, 0);
+    const std::vector<std::uint8_t> &mixed_bytes = writer.encode(mixed, 96);
+    mt::parseMidi(mixed_bytes.data(), mixed_bytes.size(), file);
+    REQUIRE(file.format == 1);
+    REQUIRE(file.track_count == 3);
+    REQUIRE(file.notes.size() == 5);
+    REQUIRE(file.notes.ticks == std::vector<std::uint32_t>{0, 480, 480, 200000000, 960});
+    REQUIRE(file.notes.durations == std::vector<std::uint32_t>{480, 480, 0, 10, 240});
+    REQUIRE(file.notes.notes == std::vector<std::uint8_t>{60, 60, 62, 64, 67});
+    REQUIRE(file.notes.channels == std::vector<std::uint8_t>{0, 0, 9, 0, 1});
+    REQUIRE(file.notes.tracks == std::vector<std::uint16_t>{0, 0, 0, 0, 2});
+    REQUIRE(file.notes.velocities == std::vector<std::uint8_t>{80, 81, 82, 83, 90});
+
+    mt::MidiNotes too_far;
+    too_far.append(0, 1, 60);
+    too_far.append(0x10000001, 1, 60);
+    REQUIRE_THROWS_AS(writer.encode(too_far), mt::MidiFileException);
+    REQUIRE_THROWS_AS(too_far.append(0, 1, 128), mt::MidiFileException);
+    REQUIRE_THROWS_AS(too_far.append(0, 1, 60, 0), mt::MidiFileException);
+    REQUIRE_THROWS_AS(too_far.append(0xFFFFFFFF, 1, 60), mt::MidiFileException);
+
+    const char *path = "mt_test_write.mid";
+    mt::writeMidiFile(path, scale, 96);
+    mt::readMidiFile(path, file);
+    std::remove(path);
+    REQUIRE(file.division == 96);
+    REQUIRE(file.notes.notes == scale.notes);
+}
+
+TEST_CASE("Note events can be stored in columns, sliced and sorted by onset", "[Events]")
+{
+    std::pmr::monotonic_buffer_resource arena;
+    mt::EventStore store(&arena);
+    REQUIRE(store.empty());
+    REQUIRE(store.isSorted());
+    REQUIRE(store.slice(0, 100).size == 0);
+
+    mt::PackedPitch c4, e4(mt::Key::Type::E), g4(mt::Key::Type::G);
+    store.append(0, 480, c4, 80, 0);
+    store.append(480, 480, e4, 81, 1);
+    store.append(480, 240, g4, 82, 2);
+    store.append(960, 480, c4, 83, 0);
+    REQUIRE(store.size() == 4);
+    REQUIRE(store.isSorted());
+
+    mt::EventView bar = store.slice(480, 960);
+    REQUIRE(bar.size == 2);
+    REQUIRE(bar.onsets == store.getOnsets() + 1);
+    REQUIRE(bar.pitches[0] == e4);
+    REQUIRE(bar.pitches[1] == g4);
+    REQUIRE(bar.voices[1] == 2);
+    REQUIRE(store.slice(481, 960).size == 0);
+    REQUIRE(store.slice(0, 1).size == 1);
+    REQUIRE(store.slice(961, 0).size == 0);
+    REQUIRE(store.slice(0, 0xFFFFFFFF).size == 4);
+
+    // Out of order appends sort stably: ties keep their append order
+    store.append(480, 10, c4, 84, 3);
+    store.append(0, 10, g4, 85, 4);
+    REQUIRE_FALSE(store.isSorted());
+    REQUIRE_THROWS_AS(store.slice(0, 480), std::logic_error);
+    store.sortByOnset();
+    REQUIRE(store.isSorted());
+    mt::EventView all = store.view();
+    REQUIRE(std::vector<std::uint32_t>(all.onsets, all.onsets + all.size) ==
+            std::vector<std::uint32_t>{0, 0, 480, 480, 480, 960});
+    REQUIRE(std::vector<std::uint8_t>(all.velocities, all.velocities + all.size) ==
+            std::vector<std::uint8_t>{80, 85, 81, 82, 84, 83});
+    REQUIRE(std::vector<std::uint16_t>(all.voices, all.voices + all.size) ==
+            std::vector<std::uint16_t>{0, 4, 1, 2, 3, 0});
+    REQUIRE(std::vector<std::uint32_t>(all.durations, all.durations + all.size) ==
+            std::vector<std::uint32_t>{480, 10, 480, 240, 10, 480});
+    REQUIRE(all.pitches[1] == g4);
+    REQUIRE(store.slice(480, 481).size == 3);
+
+    mt::EventStore moved(std::move(store));
+    REQUIRE(moved.size() == 6);
+    moved.clear();
+    REQUIRE(moved.empty());
+    REQUIRE(moved.isSorted());
+    REQUIRE_THROWS_AS(moved.reserve(mt::EventStore::max_size + std::size_t(1)), std::length_error);
+
+    // A store owning its arena
+    mt::EventStore owning;
+    owning.reserve(1000);
+    for (std::uint32_t i = 1000; i > 0; --i)
+    {
+        owning.append(i % 100, i, mt::PackedPitch::fromMidi(static_cast<std::uint8_t>(i % 128)));
+    }
+    owning.sortByOnset();
+    REQUIRE(owning.slice(10, 20).size == 100);
+    REQUIRE(std::is_sorted(owning.getOnsets(), owning.getOnsets() + owning.size()));
+    bool rows_intact = true;
+    for (std::size_t i = 0; i < owning.size(); ++i)
+    {
+        rows_intact = rows_intact && owning.getOnsets()[i] == owning.getDurations()[i] % 100 &&
+                      owning.getPitches()[i] == mt::PackedPitch::fromMidi(owning.getDurations()[i] % 128) &&
+                      (i == 0 || owning.getOnsets()[i] != owning.getOnsets()[i - 1] ||
+                       owning.getDurations()[i] < owning.getDurations()[i - 1]);
+    }
+    REQUIRE(rows_intact);
+}
+
+TEST_CASE("Note events can be written to and read from binary corpora", "[Corpus]")
+{
+    mt::CorpusWriter writer;
+    std::vector<std::uint8_t> empty_bytes = writer.encode();
+    REQUIRE(empty_bytes.size() % 64 == 0);
+    mt::Corpus empty(empty_bytes.data(), empty_bytes.size());
+    REQUIRE(empty.scoreCount() == 0);
+    REQUIRE(empty.eventCount() == 0);
+    REQUIRE_THROWS_AS(empty.getScore(0), std::out_of_range);
+
+    mt::EventStore store;
+    mt::PackedPitch d4(mt::Key::Type::D), f_sharp4(mt::Key::Type::F, mt::Accidental::Type::sharp);
+    store.append(0, 240, d4, 70, 1);
+    store.append(240, 240, f_sharp4, 71, 2);
+    store.append(480, 480, d4, 72, 1);
+    writer.add(store, 96);
+
+    mt::MidiNotes notes;
+    notes.append(480, 480, 61, 90, 3, 1);
+    notes.append(0, 480, 60, 80, 0, 0);
+    mt::MidiWriter midi_writer;
+    const std::vector<std::uint8_t> &midi_bytes = midi_writer.encode(notes, 240);
+    writer.add(mt::parseMidi(midi_bytes.data(), midi_bytes.size()), false);
+    REQUIRE(writer.scoreCount() == 2);
+
+    mt::EventStore unsorted;
+    unsorted.append(10, 1, d4);
+    unsorted.append(0, 1, d4);
+    REQUIRE_THROWS_AS(writer.add(unsorted), std::logic_error);
+
+    std::vector<std::uint8_t> bytes = writer.encode();
+    REQUIRE(bytes.size() % 64 == 0);
+    mt::Corpus corpus(bytes.data(), bytes.size());
+    REQUIRE(corpus.scoreCount() == 2);
+    REQUIRE(corpus.eventCount() == 5);
+    REQUIRE(corpus.getDivision(0) == 96);
+    REQUIRE(corpus.getDivision(1) == 240);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(corpus.getEvents().onsets) % 64 ==
+            reinterpret_cast<std::uintptr_t>(bytes.data()) % 64);
+
+    mt::EventView first = corpus.getScore(0);
+    REQUIRE(first.size == 3);
+    REQUIRE(first.pitches[1] == f_sharp4);
+    REQUIRE(first.voices[1] == 2);
+    REQUIRE(first.velocities[2] == 72);
+    REQUIRE(mt::sliceByOnset(first, 200, 500).size == 2);
+
+    // MIDI notes come in sorted by onset, spelled as asked, with track * 16 + channel voices
+    mt::EventView second = corpus.getScore(1);
+    REQUIRE(second.size == 2);
+    REQUIRE(second.onsets[0] == 0);
+    REQUIRE(second.onsets[1] == 480);
+    REQUIRE(second.durations[1] == 480);
+    REQUIRE(second.pitches[1] == mt::PackedPitch(mt::Key::Type::D, mt::Accidental::Type::flat));
+    REQUIRE(second.voices[0] == 0);
+    REQUIRE(second.voices[1] == 19);
+    REQUIRE_THROWS_AS(corpus.getDivision(2), std::out_of_range);
+
+    // Corrupt corpora are rejected before anything is read from the columns
+    std::vector<std::uint8_t> bad = bytes;
+    bad[0] = 'X';
+    REQUIRE_THROWS_AS(mt::Corpus(bad.data(), bad.size()), mt::CorpusException);
+    bad = bytes;
+    bad[8] = 2;
+    REQUIRE_THROWS_AS(mt::Corpus(bad.data(), bad.size()), mt::CorpusException);
+    REQUIRE_THROWS_AS(mt::Corpus(bytes.data(), bytes.size() - 64), mt::CorpusException);
+    REQUIRE_THROWS_AS(mt::Corpus(bytes.data(), 100), mt::CorpusException);
+    bad = bytes;
+    bad[48] += 8;
+    REQUIRE_THROWS_AS(mt::Corpus(bad.data(), bad.size()), mt::CorpusException);
+    bad = bytes;
+    bad[56] = 0xFF;
+    bad[57] = 0xFF;
+    REQUIRE_THROWS_AS(mt::Corpus(bad.data(), bad.size()), mt::CorpusException);
+    bad = bytes;
+    bad[24] = 6;
+    REQUIRE_THROWS_AS(mt::Corpus(bad.data(), bad.size()), mt::CorpusException);
+
+    const char *midi_path = "mt_test_corpus.mid";
+    const char *corpus_path = "mt_test_corpus.mtc";
+    mt::writeMidiFile(midi_path, notes, 240);
+    mt::convertMidiFiles({midi_path, midi_path}, corpus_path);
+    {
+        mt::Corpus from_file(corpus_path);
+        REQUIRE(from_file.scoreCount() == 2);
+        REQUIRE(from_file.eventCount() == 4);
+        REQUIRE(from_file.getScore(1).pitches[1] == mt::PackedPitch(mt::Key::Type::C, mt::Accidental::Type::sharp));
+    }
+    std::remove(midi_path);
+    std::remove(corpus_path);
+    REQUIRE_THROWS_AS(mt::Corpus(corpus_path), std::system_error);
+
+    writer.clear();
+    REQUIRE(writer.scoreCount() == 0);
+    REQUIRE(writer.encode().size() == empty_bytes.size());
+}
+
+TEST_CASE("Thread pools run every task of a batch once", "[ThreadPool]")
+{
+    REQUIRE(mt::ThreadPool().size() >= 1);
+    for (std::size_t threads : {1, 3, 4})
+    {
+        mt::ThreadPool pool(threads);
+        REQUIRE(pool.size() == threads);
+        for (std::size_t count : {0, 1, 2, 1000})
+        {
+            std::vector<std::atomic<int>> runs(count);
+            std::atomic<bool> workers_in_range{true};
+            pool.run(count, [&](std::size_t task, std::size_t worker) {
+                ++runs[task];
+                if (worker >= threads)
+                {
+                    workers_in_range = false;
+                }
+            });
+            REQUIRE(std::all_of(runs.begin(), runs.end(), [](const std::atomic<int> &r) { return r == 1; }));
+            REQUIRE(workers_in_range);
+        }
+
+        REQUIRE_THROWS_AS(pool.run(100,
+                                   [](std::size_t task, std::size_t) {
+                                       if (task == 42)
+                                       {
+                                           throw std::runtime_error("task failed");
+                                       }
+                                   }),
+                          std::runtime_error);
+        std::atomic<std::size_t> total{0};
+        pool.run(10, [&](std::size_t task, std::size_t) { total += task; });
+        REQUIRE(total == 45);
+    }
+}
+
+TEST_CASE("Score files can be loaded into a corpus in parallel", "[Corpus][ThreadPool]")
+{
+    std::vector<std::string> paths;
+    for (int f = 0; f < 7; ++f)
+    {
+        mt::MidiNotes notes;
+        for (int n = 0; n < 10 * f; ++n)
+        {
+            notes.append(static_cast<std::uint32_t>((n * 37) % 500), 60, static_cast<std::uint8_t>(40 + n % 50), 64,
+                         static_cast<std::uint8_t>(n % 3), static_cast<std::uint16_t>(n % 2));
+        }
+        paths.push_back("mt_test_load_" + std::to_string(f) + ".mid");
+        mt::writeMidiFile(paths.back(), notes, static_cast<std::uint16_t>(96 + f));
+    }
+    const char *serial_path = "mt_test_load.mtc";
+    mt::convertMidiFiles(paths, serial_path);
+    std::vector<std::uint8_t> serial;
+    {
+        mt::MappedFile serial_file(serial_path);
+        serial.assign(serial_file.data(), serial_file.data() + serial_file.size());
+    }
+    std::remove(serial_path);
+
+    // The same corpus whatever the number of threads
+    for (std::size_t threads : {1, 2, 4})
+    {
+        mt::ThreadPool pool(threads);
+        mt::CorpusWriter writer;
+        mt::loadScoreFiles(paths, writer, pool);
+        REQUIRE(writer.scoreCount() == paths.size());
+        REQUIRE(writer.encode() == serial);
+    }
+    mt::Corpus corpus(serial.data(), serial.size());
+    REQUIRE(corpus.getDivision(6) == 102);
+    REQUIRE(corpus.getScore(0).size == 0);
+    REQUIRE(corpus.getScore(6).size == 60);
+
+    mt::ThreadPool pool(2);
+    mt::CorpusWriter writer;
+    std::FILE *bad = std::fopen(paths[3].c_str(), "wb");
+    std::fputs("not a MIDI file", bad);
+    std::fclose(bad);
+    REQUIRE_THROWS_WITH(mt::loadScoreFiles(paths, writer, pool), Catch::Contains(paths[3]));
+    REQUIRE(writer.scoreCount() == 0);
+    for (const std::string &path : paths)
+    {
+        std::remove(path.c_str());
+    }
+    REQUIRE_THROWS_AS(mt::loadScoreFiles(paths, writer, pool), std::system_error);
+
+    // A directory of MIDI files and pitch lists, found recursively and loaded in path order
+    const std::filesystem::path directory = "mt_test_scores";
+    std::filesystem::create_directories(directory / "b");
+    mt::MidiNotes notes;
+    notes.append(0, 96, 61, 90);
+    mt::writeMidiFile((directory / "a.mid").string(), notes, 96);
+    const std::string melody = "C4 E4, G4\nBb4\n";
+    mt::writeWholeFile((directory / "b" / "melody.txt").string(), melody.data(), melody.size());
+    mt::writeWholeFile((directory / "b" / "empty.txt").string(), "", 0);
+    mt::writeWholeFile((directory / "notes.csv").string(), "C4", 2);
+    std::vector<std::string> found = mt::findScoreFiles(directory.string());
+    REQUIRE(found.size() == 3);
+    REQUIRE(std::filesystem::path(found[0]).filename() == "a.mid");
+    REQUIRE(std::filesystem::path(found[2]).filename() == "melody.txt");
+
+    mt::loadScoreDirectory(directory.string(), writer, pool, false);
+    REQUIRE(writer.scoreCount() == 3);
+    std::vector<std::uint8_t> bytes = writer.encode();
+    mt::Corpus loaded(bytes.data(), bytes.size());
+    REQUIRE(loaded.getScore(0).pitches[0] == mt::PackedPitch(mt::Key::Type::D, mt::Accidental::Type::flat));
+    REQUIRE(loaded.getScore(1).size == 0);
+    mt::EventView text = loaded.getScore(2);
+    REQUIRE(loaded.getDivision(2) == 480);
+    REQUIRE(text.size == 4);
+    REQUIRE(text.onsets[3] == 3 * 480);
+    REQUIRE(text.durations[3] == 480);
+    REQUIRE(text.pitches[3] == mt::PackedPitch(mt::Key::Type::B, mt::Accidental::Type::flat));
+
+    writer.clear();
+    mt::writeWholeFile((directory / "b" / "empty.txt").string(), "C4 H4", 5);
+    REQUIRE_THROWS_WITH(mt::loadScoreDirectory(directory.string(), writer, pool),
+                        Catch::Contains("empty.txt") && Catch::Contains("byte 3"));
+    REQUIRE(writer.scoreCount() == 0);
+    std::filesystem::remove_all(directory);
+    REQUIRE_THROWS_AS(mt::loadScoreDirectory(directory.string(), writer, pool), std::filesystem::filesystem_error);
+}